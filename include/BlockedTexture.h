@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <agz-utils/texture.h>
+#include "HugePages.h"
+
+template<typename T>
+using Texture = agz::texture::texture2d_t<T>;
+
+template<typename T, int BlockSize>
+class BlockedTextureView;
+
+// Texture stored as BlockSize x BlockSize pixel blocks, each block contiguous
+// and blocks in row-major order. A tile or overlap strip then spans a few
+// blocks (and pages) instead of one page per pixel row.
+template<typename T, int BlockSize = 32>
+class BlockedTexture
+{
+    static_assert(BlockSize > 0 && (BlockSize & (BlockSize - 1)) == 0,
+                  "BlockSize must be a power of two");
+
+public:
+
+    static constexpr int BLOCK_SIZE = BlockSize;
+
+    BlockedTexture() = default;
+
+    BlockedTexture(int height, int width)
+    {
+        initialize(height, width);
+    }
+
+    explicit BlockedTexture(const Texture<T> &texture)
+    {
+        initialize(texture.height(), texture.width());
+        for(int y = 0; y < height_; ++y)
+        {
+            for(int x = 0; x < width_; ++x)
+                (*this)(y, x) = texture(y, x);
+        }
+    }
+
+    void initialize(int height, int width)
+    {
+        width_   = width;
+        height_  = height;
+        blocksX_ = (width + BlockSize - 1) / BlockSize;
+
+        const int blocksY = (height + BlockSize - 1) / BlockSize;
+        data_.assign(static_cast<size_t>(blocksX_) * blocksY * BlockSize * BlockSize, T());
+    }
+
+    int width() const noexcept { return width_; }
+
+    int height() const noexcept { return height_; }
+
+    T &operator()(int y, int x) noexcept { return data_[index(y, x)]; }
+
+    const T &operator()(int y, int x) const noexcept { return data_[index(y, x)]; }
+
+    // pointer to pixel (y, x); the following pixels of the row are contiguous
+    // up to the end of its block, see spanLength
+    const T *span(int y, int x) const noexcept { return &data_[index(y, x)]; }
+
+    static int spanLength(int x) noexcept { return BlockSize - (x & (BlockSize - 1)); }
+
+    BlockedTextureView<T, BlockSize> subview(
+        int yBeg, int yEnd, int xBeg, int xEnd) const noexcept
+    {
+        return BlockedTextureView<T, BlockSize>(*this, yBeg, yEnd, xBeg, xEnd);
+    }
+
+    Texture<T> toTexture() const
+    {
+        Texture<T> result(height_, width_);
+        for(int y = 0; y < height_; ++y)
+        {
+            for(int x = 0; x < width_; ++x)
+                result(y, x) = (*this)(y, x);
+        }
+        return result;
+    }
+
+    size_t byteSize() const noexcept { return data_.size() * sizeof(T); }
+
+private:
+
+    size_t index(int y, int x) const noexcept
+    {
+        constexpr int shift = blockShift();
+        const size_t block = static_cast<size_t>(y >> shift) * blocksX_ + (x >> shift);
+        return (block << (2 * shift))
+             + ((y & (BlockSize - 1)) << shift)
+             + (x & (BlockSize - 1));
+    }
+
+    static constexpr int blockShift() noexcept
+    {
+        int shift = 0;
+        while((1 << shift) < BlockSize)
+            ++shift;
+        return shift;
+    }
+
+    int width_   = 0;
+    int height_  = 0;
+    int blocksX_ = 0;
+
+    HugePageVector<T> data_;
+};
+
+// Read-only rectangular view of a BlockedTexture, with the same interface as
+// TextureView.
+template<typename T, int BlockSize = 32>
+class BlockedTextureView
+{
+public:
+
+    BlockedTextureView(
+        const BlockedTexture<T, BlockSize> &texture,
+        int yBeg, int yEnd, int xBeg, int xEnd) noexcept
+        : texture_(&texture), x0_(xBeg), y0_(yBeg),
+          width_(xEnd - xBeg), height_(yEnd - yBeg)
+    {
+
+    }
+
+    int width() const noexcept { return width_; }
+
+    int height() const noexcept { return height_; }
+
+    const T &operator()(int y, int x) const noexcept { return (*texture_)(y0_ + y, x0_ + x); }
+
+private:
+
+    const BlockedTexture<T, BlockSize> *texture_;
+
+    int x0_;
+    int y0_;
+    int width_;
+    int height_;
+};
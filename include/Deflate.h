@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Checksums, deflate and inflate of PNG data, by zlib.
+
+uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size) noexcept;
+
+uint32_t adler32(uint32_t adler, const uint8_t *data, size_t size) noexcept;
+
+// Adler-32 of the concatenation of two byte sequences from the checksums of
+// both and the size of the second
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondSize) noexcept;
+
+// two-byte zlib (RFC 1950) header of a deflate stream with a 32KB window
+void writeZlibHeader(int level, std::vector<uint8_t> &out);
+
+// Deflates a strip of a longer stream independently of the other strips:
+// matches may reach back into dictionary (up to 32KB of the bytes before the
+// strip), and the strip ends on a byte boundary with an empty stored block,
+// or with the final block when final. The raw deflate data of consecutive
+// strips thus concatenates to one stream, as in pigz.
+void deflateStrip(
+    const uint8_t        *data,
+    size_t                size,
+    const uint8_t        *dictionary,
+    size_t                dictionarySize,
+    int                   level,
+    bool                  final,
+    std::vector<uint8_t> &out);
+
+// Inflates a zlib (RFC 1950) stream piece by piece as its compressed bytes
+// arrive, e.g. PNG image data chunk by chunk.
+class ZlibInflater
+{
+public:
+
+    ZlibInflater();
+
+    ~ZlibInflater();
+
+    ZlibInflater(const ZlibInflater &) = delete;
+
+    ZlibInflater &operator=(const ZlibInflater &) = delete;
+
+    // next compressed bytes, which must stay valid until needsInput
+    void feed(const uint8_t *data, size_t size);
+
+    bool needsInput() const noexcept;
+
+    // true once the end of the stream has been inflated
+    bool finished() const noexcept;
+
+    // inflates up to size bytes into out and returns how many were written;
+    // fewer when the fed bytes run out or the stream ends
+    size_t inflate(uint8_t *out, size_t size);
+
+private:
+
+    struct Stream;
+
+    std::unique_ptr<Stream> stream_;
+};
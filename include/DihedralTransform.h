@@ -0,0 +1,132 @@
+#pragma once
+
+#include <utility>
+#include <agz-utils/texture.h>
+
+// One of the eight rotations and mirrors of a width x height source: bit 0 of
+// the index mirrors the source horizontally, bits 1-2 then rotate it by that
+// many quarter turns counterclockwise. Pixel (u, v) of the transformed source
+// is source pixel
+//
+//   (originX + u * uX + v * vX, originY + u * uY + v * vY)
+//
+// so tiles of the transformed source are read by remapping indices into the
+// source instead of copying it.
+class DihedralTransform
+{
+public:
+
+    static constexpr int COUNT = 8;
+
+    DihedralTransform() = default;
+
+    DihedralTransform(int index, int sourceWidth, int sourceHeight) noexcept
+        : index_(index), width_(sourceWidth), height_(sourceHeight)
+    {
+        if(index & 1)
+        {
+            originX_ = sourceWidth - 1;
+            uX_      = -1;
+        }
+
+        // pixel (u, v) of a quarter turn is pixel (width - 1 - v, u) before it
+        for(int turn = 0; turn < (index >> 1); ++turn)
+        {
+            originX_ += uX_ * (width_ - 1);
+            originY_ += uY_ * (width_ - 1);
+
+            const int uX = uX_, uY = uY_;
+            uX_ = vX_;
+            uY_ = vY_;
+            vX_ = -uX;
+            vY_ = -uY;
+
+            std::swap(width_, height_);
+        }
+    }
+
+    int index() const noexcept { return index_; }
+
+    bool isIdentity() const noexcept { return index_ == 0; }
+
+    // size of the transformed source
+    int width() const noexcept { return width_; }
+
+    int height() const noexcept { return height_; }
+
+    agz::math::vec2i sourcePixel(int u, int v) const noexcept
+    {
+        return { originX_ + u * uX_ + v * vX_, originY_ + u * uY_ + v * vY_ };
+    }
+
+    agz::math::vec2i transformedPixel(int x, int y) const noexcept
+    {
+        const int dx = x - originX_, dy = y - originY_;
+        return { uX_ * dx + uY_ * dy, vX_ * dx + vY_ * dy };
+    }
+
+    // continuous coordinates, pixel i covering [i, i + 1)
+    void sourcePoint(double u, double v, double &x, double &y) const noexcept
+    {
+        x = originX_ + u * uX_ + v * vX_ + (uX_ + vX_ < 0 ? 1 : 0);
+        y = originY_ + u * uY_ + v * vY_ + (uY_ + vY_ < 0 ? 1 : 0);
+    }
+
+    // offsets between the source pixels of neighbouring transformed pixels,
+    // in a row-major source with stride elements per row
+    int stepU(int stride) const noexcept { return uY_ * stride + uX_; }
+
+    int stepV(int stride) const noexcept { return vY_ * stride + vX_; }
+
+private:
+
+    int index_ = 0;
+
+    int width_  = 0;
+    int height_ = 0;
+
+    int originX_ = 0;
+    int originY_ = 0;
+
+    int uX_ = 1, uY_ = 0;
+    int vX_ = 0, vY_ = 1;
+};
+
+// Read-only view of the tile at (u0, v0) of a transformed source, with the
+// same interface as TextureView. SourceTexture is Texture<Vec3> or
+// BlockedTexture<Vec3>.
+template<typename SourceTexture>
+class DihedralTileView
+{
+public:
+
+    DihedralTileView(
+        const SourceTexture     &source,
+        const DihedralTransform &transform,
+        int u0, int v0, int width, int height) noexcept
+        : source_(&source), transform_(transform),
+          u0_(u0), v0_(v0), width_(width), height_(height)
+    {
+
+    }
+
+    int width() const noexcept { return width_; }
+
+    int height() const noexcept { return height_; }
+
+    const agz::math::float3 &operator()(int y, int x) const noexcept
+    {
+        const agz::math::vec2i xy = transform_.sourcePixel(u0_ + x, v0_ + y);
+        return (*source_)(xy.y, xy.x);
+    }
+
+private:
+
+    const SourceTexture *source_;
+    DihedralTransform    transform_;
+
+    int u0_;
+    int v0_;
+    int width_;
+    int height_;
+};
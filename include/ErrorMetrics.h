@@ -1,6 +1,9 @@
 #pragma once
 
 #include <agz-utils/texture.h>
+#include "BlockedTexture.h"
+#include "DihedralTransform.h"
+#include "LuminanceStatistics.h"
 
 using Vec3 = agz::math::float3;
 
@@ -21,3 +24,187 @@ float calculateMSE(
     int tileH,
     int seamW,
     int seamH);
+
+// Squared error sum over a rectangle, computed as
+// sum(a^2) + sum(b^2) - 2 * sum(a * b) from precomputed luminance statistics.
+float calculateErrorSum(
+    const SourceStatistics &A, int xA, int yA,
+    const TargetStatistics &B, int xB, int yB,
+    int width, int height);
+
+// Same with sum(b^2) = B.squaredSum(xB, yB, width, height) given, for callers
+// comparing many candidates against one target rectangle.
+float calculateErrorSum(
+    const SourceStatistics &A, int xA, int yA,
+    const TargetStatistics &B, int xB, int yB,
+    int width, int height,
+    double squaredSumB);
+
+// Squared target luminance sums of the left strip (including the corner) and
+// the rest of the top strip of the L-shaped overlap at (tgtX, tgtY). They do
+// not depend on the candidate, so they are computed once per tile.
+struct TargetOverlapSums
+{
+    double left = 0;
+    double top  = 0;
+};
+
+TargetOverlapSums calculateTargetOverlapSums(
+    const TargetStatistics &target,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH);
+
+// Same L-shaped overlap error as above, from the error sums of the
+// statistics.
+float calculateMSE(
+    const SourceStatistics &source,
+    const TargetStatistics &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH);
+
+// Same with the target sums of calculateTargetOverlapSums given.
+float calculateMSE(
+    const SourceStatistics  &source,
+    const TargetStatistics  &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH,
+    const TargetOverlapSums &targetSums);
+
+// Number of horizontally adjacent candidates scored by calculateMSEBatch.
+constexpr int MSE_BATCH_SIZE = 8;
+
+// Fast-metric MSE of the MSE_BATCH_SIZE candidates (srcX + i, srcY). Every
+// target overlap pixel is loaded once and compared against all candidates,
+// so the kernel vectorizes across candidates instead of within one, which
+// pays off for narrow overlaps such as the default seamW = tileW / 6.
+// targetSums are the target's of calculateTargetOverlapSums. Requires srcX + MSE_BATCH_SIZE - 1 + tileW <= source width.
+void calculateMSEBatch(
+    const SourceStatistics &source,
+    const TargetStatistics &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH,
+    const TargetOverlapSums &targetSums,
+    float (&result)[MSE_BATCH_SIZE]);
+
+// Integer path for 8-bit sources: exact sum of squared differences of
+// fixed-point luminance, accumulated in 32-bit lanes per row.
+int64_t calculateErrorSum(
+    const FixedPointLuminancePlane &A, int xA, int yA,
+    const FixedPointLuminancePlane &B, int xB, int yB,
+    int width, int height);
+
+// Same L-shaped overlap error as the float calculateMSE, in the same units.
+float calculateMSE(
+    const FixedPointLuminancePlane &source,
+    const FixedPointLuminancePlane &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH);
+
+// Overlap error on blocked storage: walks each overlap row block by block
+// instead of column by column.
+float calculateErrorSum(
+    const BlockedTexture<Vec3> &A, int xA, int yA,
+    const BlockedTexture<Vec3> &B, int xB, int yB,
+    int width, int height);
+
+float calculateMSE(
+    const BlockedTexture<Vec3> &source,
+    const BlockedTexture<Vec3> &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH);
+
+// Squared error sums between the rectangle at (uA, vA) of the source
+// transformed by transform and the target rectangle at (xB, yB), reading the
+// source luminance through the transform's index remapping.
+float calculateErrorSum(
+    const LuminancePlane &A, const DihedralTransform &transform, int uA, int vA,
+    const Texture<Vec3> &B, int xB, int yB,
+    int width, int height);
+
+float calculateErrorSum(
+    const LuminancePlane &A, const DihedralTransform &transform, int uA, int vA,
+    const TargetStatistics &B, int xB, int yB,
+    int width, int height);
+
+float calculateErrorSum(
+    const LuminancePlane &A, const DihedralTransform &transform, int uA, int vA,
+    const BlockedTexture<Vec3> &B, int xB, int yB,
+    int width, int height);
+
+int64_t calculateErrorSum(
+    const FixedPointLuminancePlane &A, const DihedralTransform &transform, int uA, int vA,
+    const FixedPointLuminancePlane &B, int xB, int yB,
+    int width, int height);
+
+// Overlap error of the tile at (srcX, srcY) of the source transformed by
+// transform, reading the source luminance through the transform's index
+// remapping. lum(a - b) = lum(a) - lum(b), so this is the float
+// calculateMSE's error; the target is read in the representation of the
+// metric path in use.
+float calculateMSE(
+    const LuminancePlane    &source,
+    const DihedralTransform &transform,
+    const Texture<Vec3>     &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH);
+
+float calculateMSE(
+    const LuminancePlane    &source,
+    const DihedralTransform &transform,
+    const TargetStatistics  &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH);
+
+float calculateMSE(
+    const LuminancePlane       &source,
+    const DihedralTransform    &transform,
+    const BlockedTexture<Vec3> &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH);
+
+// Exact integer variant of the above for the fixed-point path.
+float calculateMSE(
+    const FixedPointLuminancePlane &source,
+    const DihedralTransform        &transform,
+    const FixedPointLuminancePlane &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH);
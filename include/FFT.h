@@ -0,0 +1,55 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+#include "LuminanceStatistics.h"
+
+// In-place radix-2 FFT of count (a power of two) values spaced stride apart.
+// The inverse transform is unnormalized.
+void fft(std::complex<double> *data, int count, int stride, bool inverse);
+
+// 2D FFT of a row-major width x height array, both powers of two.
+void fft2D(std::complex<double> *data, int width, int height, bool inverse);
+
+// Cross-correlation of a fixed plane with patterns of a fixed size,
+//
+//   result(x, y) = sum_{i, j} plane(x + i, y + j) * pattern(i, j)
+//
+// for every position where the pattern lies inside the plane, via one FFT of
+// the pattern and one inverse FFT per call instead of
+// patternWidth * patternHeight operations per position. The plane's spectrum
+// is computed once; correlate may be called concurrently.
+class PlaneCorrelator
+{
+public:
+
+    PlaneCorrelator(const LuminancePlane &plane, int patternWidth, int patternHeight);
+
+    // positions per row and column of the result
+    int resultWidth() const noexcept { return resultWidth_; }
+
+    int resultHeight() const noexcept { return resultHeight_; }
+
+    // pattern is row-major with patternStride floats per row; result receives
+    // resultWidth() * resultHeight() values in row-major order
+    void correlate(
+        const float        *pattern,
+        int                 patternStride,
+        std::vector<float> &result) const;
+
+    size_t byteSize() const noexcept { return spectrum_.size() * sizeof(std::complex<double>); }
+
+private:
+
+    int patternWidth_;
+    int patternHeight_;
+
+    int resultWidth_;
+    int resultHeight_;
+
+    // padded transform size
+    int fftWidth_;
+    int fftHeight_;
+
+    std::vector<std::complex<double>> spectrum_;
+};
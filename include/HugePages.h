@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+enum class HugePageMode
+{
+    // regular pages
+    Off,
+
+    // 2MB-aligned anonymous mappings with madvise(MADV_HUGEPAGE)
+    Transparent,
+
+    // MAP_HUGETLB mappings from the preallocated pool, falling back to
+    // Transparent when the pool is exhausted
+    Explicit,
+};
+
+constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+// Process-wide policy for buffers of at least thresholdBytes. Huge pages are
+// only available on Linux; elsewhere every mode behaves like Off.
+void setHugePagePolicy(HugePageMode mode, size_t thresholdBytes = HUGE_PAGE_SIZE);
+
+HugePageMode hugePageMode() noexcept;
+
+size_t hugePageThreshold() noexcept;
+
+// Advises the kernel to back the 2MB-aligned interior of an existing buffer
+// with transparent huge pages, for buffers not allocated by
+// HugePageAllocator (e.g. agz textures). Most effective before the buffer is
+// first touched. Returns false when the policy is Off, the buffer is below
+// the threshold or the advice failed.
+bool adviseHugePages(void *data, size_t bytes) noexcept;
+
+// Huge page backed allocation of at least bytes, for mode Transparent or
+// Explicit. Throws std::bad_alloc on failure.
+void *allocateHugePages(size_t bytes, HugePageMode mode);
+
+void deallocateHugePages(void *data, size_t bytes) noexcept;
+
+// Standard allocator placing allocations above the threshold on huge pages.
+// The policy is captured on construction, so buffers are released the way
+// they were allocated even if the policy changes in between.
+template<typename T>
+class HugePageAllocator
+{
+public:
+
+    using value_type = T;
+
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+    using is_always_equal                        = std::false_type;
+
+    HugePageAllocator() noexcept
+        : mode_(hugePageMode()), threshold_(hugePageThreshold())
+    {
+
+    }
+
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U> &other) noexcept
+        : mode_(other.mode()), threshold_(other.threshold())
+    {
+
+    }
+
+    T *allocate(size_t n)
+    {
+        const size_t bytes = n * sizeof(T);
+        if(!usesHugePages(bytes))
+            return static_cast<T*>(::operator new(bytes));
+        return static_cast<T*>(allocateHugePages(bytes, mode_));
+    }
+
+    void deallocate(T *p, size_t n) noexcept
+    {
+        const size_t bytes = n * sizeof(T);
+        if(!usesHugePages(bytes))
+            ::operator delete(p);
+        else
+            deallocateHugePages(p, bytes);
+    }
+
+    HugePageMode mode() const noexcept { return mode_; }
+
+    size_t threshold() const noexcept { return threshold_; }
+
+    template<typename U>
+    bool operator==(const HugePageAllocator<U> &rhs) const noexcept
+    {
+        return mode_ == rhs.mode() && threshold_ == rhs.threshold();
+    }
+
+    template<typename U>
+    bool operator!=(const HugePageAllocator<U> &rhs) const noexcept
+    {
+        return !(*this == rhs);
+    }
+
+private:
+
+    bool usesHugePages(size_t bytes) const noexcept
+    {
+        return mode_ != HugePageMode::Off && bytes >= threshold_;
+    }
+
+    HugePageMode mode_;
+    size_t       threshold_;
+};
+
+template<typename T>
+using HugePageVector = std::vector<T, HugePageAllocator<T>>;
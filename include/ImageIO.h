@@ -0,0 +1,164 @@
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <agz-utils/texture.h>
+
+using Vec3 = agz::math::float3;
+
+template<typename T>
+using Texture = agz::texture::texture2d_t<T>;
+
+// Encodes an image from top to bottom rows or from tiles, writing the encoded
+// data as they arrive, so that neither the encoded image nor (with a row or
+// tile producer) the pixels ever have to be held in memory as a whole. A
+// writer takes either rows or tiles, not both.
+class ImageWriter
+{
+public:
+
+    virtual ~ImageWriter() = default;
+
+    // width pixels
+    virtual void writeRow(const Vec3 *row) = 0;
+
+    // width x height pixels at x, y, whose rows are stride pixels apart.
+    // Tiles must not overlap and may arrive in any order, but scanline
+    // formats hold the rows below the first incomplete one until it is
+    // complete; tiled formats take only the tiles of their own grid.
+    virtual void writeTile(int x, int y, int width, int height, const Vec3 *pixels, size_t stride) = 0;
+
+    // after the last row or tile; throws when some are missing or out failed
+    virtual void finish() = 0;
+};
+
+struct ImageWriterOptions
+{
+    // deflate level of PNG, 0 (stored) to 9; 1 is a good deal faster than
+    // the default at slightly larger files, e.g. for intermediate assets
+    int compressionLevel = 6;
+
+    // PNG rows are deflated in strips of about 256KB, each primed with the
+    // last 32KB of the previous one, on up to this many threads while later
+    // rows arrive. The file is the same for any thread count.
+    int threads = 1;
+
+    // tile width and height of tiled formats
+    int tileSize = 64;
+};
+
+// One image file format: the names it is known by and how images are read
+// and written. Formats are looked up in an ImageFormatRegistry; the loading
+// and saving functions below take them from the global one.
+class ImageFormat
+{
+public:
+
+    virtual ~ImageFormat() = default;
+
+    // lower-case name for --format, e.g. "png16"
+    virtual std::string name() const = 0;
+
+    // lower-case file extensions without the dot that select this format
+    virtual std::vector<std::string> extensions() const = 0;
+
+    // false when images are only saved as a whole and createWriter throws
+    virtual bool streamable() const noexcept { return true; }
+
+    // writer of a width x height image to out, which must outlive it
+    virtual std::unique_ptr<ImageWriter> createWriter(
+        std::ostream             &out,
+        int                       width,
+        int                       height,
+        const ImageWriterOptions &options) const = 0;
+
+    virtual Texture<Vec3> read(std::istream &in) const = 0;
+
+    // by default reads the opened file
+    virtual Texture<Vec3> load(const std::string &filename) const;
+
+    // by default writes all rows through a writer of the opened file
+    virtual void save(
+        const std::string        &filename,
+        const Texture<Vec3>      &texture,
+        const ImageWriterOptions &options) const;
+};
+
+// Formats by name and extension. The global registry starts out with
+// - png:   8-bit RGB PNG; any PNG on input
+// - png16: 16-bit RGB PNG (no extension of its own, read as png)
+// - jpg:   JPEG, encoded by agz-utils into files only
+// - bmp:   24-bit bitmap
+// - ppm:   binary portable pixmap, 8- or 16-bit on input
+// - pfm:   portable float map, RGB float32, unclamped
+// - hft:   half-float tiles, RGB float16 in tiles of ImageWriterOptions::tileSize
+// JPG and BMP input is decoded by agz-utils at 8 bits per sample; the others
+// are decoded here as they are read, 16-bit PNG and PPM at full precision.
+// Only pfm and hft keep values outside [0, 1].
+class ImageFormatRegistry
+{
+public:
+
+    // with the built-in formats
+    ImageFormatRegistry();
+
+    // not synchronized: add formats before loading or saving images
+    static ImageFormatRegistry &global();
+
+    // replaces the format of the same name and takes over its extensions
+    void add(std::shared_ptr<const ImageFormat> format);
+
+    // by name or extension, in any case; throws when unknown
+    const ImageFormat &find(const std::string &name) const;
+
+    // format named by the extension of filename
+    const ImageFormat &ofFile(const std::string &filename) const;
+
+    std::vector<std::string> names() const;
+
+private:
+
+    std::vector<std::shared_ptr<const ImageFormat>> formats_;
+};
+
+// ImageFormatRegistry::global().find(name)
+const ImageFormat &parseImageFormat(const std::string &name);
+
+// ImageFormatRegistry::global().ofFile(filename)
+const ImageFormat &imageFormatOfFile(const std::string &filename);
+
+// format.createWriter(out, width, height, options)
+std::unique_ptr<ImageWriter> createImageWriter(
+    const ImageFormat        &format,
+    std::ostream             &out,
+    int                       width,
+    int                       height,
+    const ImageWriterOptions &options = {});
+
+// Writer of filename, which it opens like saveImage and closes when
+// finished; "-" writes stdout
+std::unique_ptr<ImageWriter> openImageWriter(
+    const std::string        &filename,
+    int                       width,
+    int                       height,
+    const ImageFormat        *format  = nullptr,
+    const ImageWriterOptions &options = {});
+
+Texture<Vec3> readImage(std::istream &in, const ImageFormat &format);
+
+// filename "-" reads stdin, which needs an explicit format; otherwise format
+// defaults to the one of the file extension
+Texture<Vec3> loadImage(
+    const std::string &filename,
+    const ImageFormat *format = nullptr);
+
+// filename "-" writes stdout, which needs an explicit format; otherwise the
+// file's directory is created and format defaults to the file extension
+void saveImage(
+    const std::string        &filename,
+    const Texture<Vec3>      &texture,
+    const ImageFormat        *format  = nullptr,
+    const ImageWriterOptions &options = {});
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "TextureQuilter.h"
+
+// Random-access synthesis of an unbounded quilted texture (x, y >= 0), e.g.
+// for virtual texturing. Instead of the raster wavefront, whose tiles depend
+// on every tile above and to the left, tiles are resolved in four phases by
+// tile coordinate parity:
+//
+//   (even, even) random source positions, placed without seams
+//   (odd,  even) matched and cut against their left and right neighbours
+//   (even, odd)  matched and cut against their top and bottom neighbours
+//   (odd,  odd)  matched and cut against all four neighbours
+//
+// Tiles of one phase do not overlap, so a tile's choice is a deterministic
+// function of the seed, its coordinates and the tiles of earlier phases
+// within one tile, and a region depends on a halo of at most three tiles.
+//
+// Resolved tiles (source position and which footprint pixels they cover after
+// the seam cut) are memoized in an LRU cache of bounded size; evicted tiles
+// are resolved again on demand, with the same result. Candidates are scored
+// exhaustively on luminance as in TextureQuilter::quiltMaskedRegion, so the
+// quilter's search mode and metric settings do not apply. Not thread-safe.
+class LazyQuilter
+{
+public:
+
+    // Takes the tile parameters, tolerance, MSE selection, min cut and seed
+    // from quilter, which needs tileWidth >= 2 * seamWidth and
+    // tileHeight >= 2 * seamHeight. Without a seed a random one is drawn.
+    LazyQuilter(
+        const TextureQuilter &quilter,
+        Texture<Vec3>         source,
+        size_t                cacheBytes = size_t(64) << 20);
+
+    unsigned seed() const noexcept { return seed_; }
+
+    Texture<Vec3> getRegion(int x0, int y0, int width, int height);
+
+    size_t cachedTileCount() const noexcept { return cache_.size(); }
+
+    // tiles resolved so far, including ones resolved again after eviction
+    uint64_t resolvedTileCount() const noexcept { return resolvedTileCount_; }
+
+private:
+
+    struct ResolvedTile
+    {
+        agz::math::vec2i source;
+
+        // tileWidth * tileHeight flags of the footprint pixels written
+        std::vector<char> coverage;
+    };
+
+    struct CacheEntry
+    {
+        std::shared_ptr<const ResolvedTile> tile;
+        std::list<uint64_t>::iterator       lruPosition;
+    };
+
+    static int phaseOf(int tileX, int tileY) noexcept;
+
+    std::shared_ptr<const ResolvedTile> resolveTile(int tileX, int tileY);
+
+    // writes the pixels of [x0, x0 + width) x [y0, y0 + height) as they are
+    // once all tiles of phases below endPhase are placed into target
+    void composite(
+        Texture<Vec3> &target,
+        int x0, int y0, int width, int height,
+        int endPhase);
+
+    TextureQuilter  quilter_;
+    Texture<Vec3>   source_;
+    LuminancePlane  sourceLum_;
+    unsigned        seed_;
+
+    int stepX_;
+    int stepY_;
+
+    size_t maxCachedTiles_;
+
+    std::unordered_map<uint64_t, CacheEntry> cache_;
+    std::list<uint64_t>                      lru_;
+
+    uint64_t resolvedTileCount_;
+};
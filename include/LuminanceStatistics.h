@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <agz-utils/texture.h>
+#include "HugePages.h"
+
+using Vec3 = agz::math::float3;
+
+template<typename T>
+using Texture = agz::texture::texture2d_t<T>;
+
+// Row-major plane of per-pixel luminance.
+class LuminancePlane
+{
+public:
+
+    LuminancePlane() = default;
+
+    explicit LuminancePlane(const Texture<Vec3> &texture);
+
+    void initialize(int width, int height);
+
+    // TextureType is Texture<Vec3> or BlockedTexture<Vec3>
+    template<typename TextureType>
+    void update(
+        const TextureType &texture,
+        int x, int y, int width, int height);
+
+    int width() const noexcept { return width_; }
+
+    int height() const noexcept { return height_; }
+
+    const float *row(int y) const noexcept { return &data_[y * width_]; }
+
+    float operator()(int y, int x) const noexcept { return data_[y * width_ + x]; }
+
+    size_t byteSize() const noexcept { return data_.size() * sizeof(float); }
+
+private:
+
+    int width_  = 0;
+    int height_ = 0;
+
+    HugePageVector<float> data_;
+};
+
+// Scale of FixedPointLuminancePlane: 4x the 8-bit range keeps the rounding
+// error of luminance well below one 8-bit step, while squared differences
+// (< 2^20) summed in pairs by madd still fit 32-bit lanes.
+constexpr int LUMINANCE_FIXED_POINT_SCALE = 1020;
+
+// Row-major plane of luminance quantized to int16 in
+// [0, LUMINANCE_FIXED_POINT_SCALE], for the integer metric path of 8-bit
+// sources. Updated the same way as LuminancePlane.
+class FixedPointLuminancePlane
+{
+public:
+
+    FixedPointLuminancePlane() = default;
+
+    explicit FixedPointLuminancePlane(const Texture<Vec3> &texture);
+
+    void initialize(int width, int height);
+
+    // TextureType is Texture<Vec3> or BlockedTexture<Vec3>
+    template<typename TextureType>
+    void update(
+        const TextureType &texture,
+        int x, int y, int width, int height);
+
+    int width() const noexcept { return width_; }
+
+    int height() const noexcept { return height_; }
+
+    const int16_t *row(int y) const noexcept { return &data_[y * width_]; }
+
+    size_t byteSize() const noexcept { return data_.size() * sizeof(int16_t); }
+
+private:
+
+    int width_  = 0;
+    int height_ = 0;
+
+    HugePageVector<int16_t> data_;
+};
+
+// Luminance plane of the source plus a summed-area table of squared luminance.
+class SourceStatistics
+{
+public:
+
+    explicit SourceStatistics(const Texture<Vec3> &source);
+
+    const LuminancePlane &luminance() const noexcept { return lum_; }
+
+    // sum of lum^2 over [x, x + width) x [y, y + height) in O(1)
+    double squaredSum(int x, int y, int width, int height) const noexcept;
+
+    size_t byteSize() const noexcept;
+
+private:
+
+    double sat(int y, int x) const noexcept { return sat_[y * (lum_.width() + 1) + x]; }
+
+    LuminancePlane         lum_;
+    HugePageVector<double> sat_;
+};
+
+// Luminance plane of the target plus prefix sums of squared luminance along
+// each row, restarting at every column block of blockWidth pixels.
+//
+// update refreshes the prefixes of every row it writes from the first written
+// column to the end of the last block it touches, so rewriting the overlap
+// band of the tile row above leaves no stale sums behind. With blockWidth set
+// to the horizontal tile step, a tile touches the blocks of its own and the
+// next tile column only; tiles placed concurrently are at least two columns
+// apart, so their updates and sums never share a block.
+class TargetStatistics
+{
+public:
+
+    TargetStatistics(int width, int height, int blockWidth);
+
+    template<typename TextureType>
+    void update(
+        const TextureType &target,
+        int x, int y, int width, int height);
+
+    const LuminancePlane &luminance() const noexcept { return lum_; }
+
+    // sum of lum^2 over [x, x + width) x [y, y + height) in
+    // O(height * (width / blockWidth + 2))
+    double squaredSum(int x, int y, int width, int height) const noexcept;
+
+    size_t byteSize() const noexcept;
+
+private:
+
+    LuminancePlane         lum_;
+    int                    blockWidth_;
+    HugePageVector<double> rowPrefix_;
+};
+
+template<typename TextureType>
+void LuminancePlane::update(
+    const TextureType &texture,
+    int x, int y, int width, int height)
+{
+    for(int yi = y; yi < y + height; ++yi)
+    {
+        float *dst = &data_[yi * width_];
+        for(int xi = x; xi < x + width; ++xi)
+            dst[xi] = texture(yi, xi).lum();
+    }
+}
+
+template<typename TextureType>
+void FixedPointLuminancePlane::update(
+    const TextureType &texture,
+    int x, int y, int width, int height)
+{
+    for(int yi = y; yi < y + height; ++yi)
+    {
+        int16_t *dst = &data_[yi * width_];
+        for(int xi = x; xi < x + width; ++xi)
+        {
+            const float lum = texture(yi, xi).lum() * LUMINANCE_FIXED_POINT_SCALE;
+            dst[xi] = static_cast<int16_t>(std::lround(agz::math::clamp(
+                lum, 0.0f, static_cast<float>(LUMINANCE_FIXED_POINT_SCALE))));
+        }
+    }
+}
+
+template<typename TextureType>
+void TargetStatistics::update(
+    const TextureType &target,
+    int x, int y, int width, int height)
+{
+    lum_.update(target, x, y, width, height);
+
+    const int rowWidth = lum_.width();
+    const int blockEnd = (std::min)(
+        rowWidth, ((x + width - 1) / blockWidth_ + 1) * blockWidth_);
+
+    for(int yi = y; yi < y + height; ++yi)
+    {
+        const float *lumRow = lum_.row(yi);
+        double *prefix = &rowPrefix_[static_cast<size_t>(yi) * rowWidth];
+
+        for(int xi = x; xi < blockEnd; ++xi)
+        {
+            const double previous = xi % blockWidth_ ? prefix[xi - 1] : 0.0;
+            prefix[xi] = previous + static_cast<double>(lumRow[xi]) * lumRow[xi];
+        }
+    }
+}
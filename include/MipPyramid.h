@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <agz-utils/texture.h>
+
+using Vec3 = agz::math::float3;
+
+template<typename T>
+using Texture = agz::texture::texture2d_t<T>;
+
+// Box-filtered mip chain: level 0 is the base texture and level l + 1 has
+// size max(1, size(l) / 2), every texel averaging a 2x2 block of level l
+// (clamped at odd borders).
+class MipPyramid
+{
+public:
+
+    // levelCount 0 builds the full chain down to 1x1
+    explicit MipPyramid(const Texture<Vec3> &base, int levelCount = 0);
+
+    int levelCount() const noexcept { return static_cast<int>(levels_.size()); }
+
+    const Texture<Vec3> &level(int index) const { return levels_[index]; }
+
+    // number of levels of a full chain for the given size
+    static int fullLevelCount(int width, int height) noexcept;
+
+private:
+
+    std::vector<Texture<Vec3>> levels_;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+struct NUMANode
+{
+    int id = 0;
+
+    std::vector<int> cpus;
+
+    // 0 when the size could not be determined
+    uint64_t memoryBytes = 0;
+};
+
+// NUMA nodes of the machine and the CPUs belonging to each, read from
+// /sys/devices/system/node on Linux. Elsewhere, or when sysfs is unavailable,
+// the machine is reported as a single node holding all hardware threads.
+class NUMATopology
+{
+public:
+
+    static NUMATopology detect();
+
+    const std::vector<NUMANode> &nodes() const noexcept { return nodes_; }
+
+    int nodeCount() const noexcept { return static_cast<int>(nodes_.size()); }
+
+    int cpuCount() const noexcept;
+
+    // -1 when the CPU belongs to no known node
+    int nodeOfCPU(int cpu) const noexcept;
+
+    void writeReport(std::ostream &out) const;
+
+private:
+
+    std::vector<NUMANode> nodes_;
+};
+
+// Restricts the calling thread to the given CPU. Returns false when pinning
+// is not supported or failed; the thread then keeps running unpinned.
+bool pinCurrentThreadToCPU(int cpu) noexcept;
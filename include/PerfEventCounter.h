@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+// Hardware event counter of the calling thread and of the threads it starts
+// while counting, via perf_event_open on Linux. available() is false when
+// the event is not supported, e.g. without permission
+// (kernel.perf_event_paranoid) or inside most virtual machines.
+class PerfEventCounter
+{
+public:
+
+    enum class Event
+    {
+        DTLBLoads,
+        DTLBLoadMisses,
+    };
+
+    explicit PerfEventCounter(Event event) noexcept;
+
+    ~PerfEventCounter();
+
+    PerfEventCounter(const PerfEventCounter &) = delete;
+    PerfEventCounter &operator=(const PerfEventCounter &) = delete;
+
+    bool available() const noexcept { return fd_ >= 0; }
+
+    void start() noexcept;
+
+    // count since start; threads started meanwhile are included once joined
+    uint64_t stop() noexcept;
+
+private:
+
+    int fd_;
+};
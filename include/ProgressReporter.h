@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+// Receives quilting progress. All calls come from a single reporter thread,
+// never from the threads placing tiles.
+class ProgressReporter
+{
+public:
+
+    virtual ~ProgressReporter() = default;
+
+    virtual void begin(int totalTiles) = 0;
+
+    virtual void update(int placedTiles, int totalTiles) = 0;
+
+    virtual void end(int totalTiles) = 0;
+};
+
+// Console progress bar, the historical behaviour of quiltTexture.
+class TTYProgressReporter : public ProgressReporter
+{
+public:
+
+    void begin(int totalTiles) override;
+
+    void update(int placedTiles, int totalTiles) override;
+
+    void end(int totalTiles) override;
+
+private:
+
+    struct Impl;
+
+    std::shared_ptr<Impl> impl_;
+};
+
+// One JSON object per line, e.g. for log collectors of batch jobs.
+class JSONLinesProgressReporter : public ProgressReporter
+{
+public:
+
+    explicit JSONLinesProgressReporter(std::ostream &out);
+
+    void begin(int totalTiles) override;
+
+    void update(int placedTiles, int totalTiles) override;
+
+    void end(int totalTiles) override;
+
+private:
+
+    double elapsedMs() const;
+
+    std::ostream                          &out_;
+    std::chrono::steady_clock::time_point  start_;
+};
+
+class SilentProgressReporter : public ProgressReporter
+{
+public:
+
+    void begin(int) override { }
+
+    void update(int, int) override { }
+
+    void end(int) override { }
+};
+
+// Owns the placed-tile counter of one quiltTexture call and a thread sampling
+// it at a fixed interval. Tile threads only pay for a relaxed atomic add.
+class ProgressMonitor
+{
+public:
+
+    ProgressMonitor(
+        ProgressReporter          *reporter,
+        int                        totalTiles,
+        std::chrono::milliseconds  interval = std::chrono::milliseconds(100));
+
+    ~ProgressMonitor();
+
+    ProgressMonitor(const ProgressMonitor &) = delete;
+    ProgressMonitor &operator=(const ProgressMonitor &) = delete;
+
+    void advance(int tiles = 1) noexcept
+    {
+        placedTiles_.fetch_add(tiles, std::memory_order_relaxed);
+    }
+
+private:
+
+    void run();
+
+    ProgressReporter          *reporter_;
+    int                        totalTiles_;
+    std::chrono::milliseconds  interval_;
+
+    std::atomic<int>           placedTiles_;
+
+    std::mutex                 mutex_;
+    std::condition_variable    cond_;
+    bool                       stop_;
+
+    std::thread                thread_;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <agz-utils/texture.h>
+#include "DihedralTransform.h"
+#include "MipPyramid.h"
+
+using Vec3 = agz::math::float3;
+
+template<typename T>
+using Texture = agz::texture::texture2d_t<T>;
+
+// Compact description of a quilted texture: the source position and the seams
+// of every tile. Rendering it copies source pixels without any search or seam
+// computation, and reproduces the quilted texture exactly with the source it
+// was quilted from.
+//
+// The source may also be a scaled version of that exemplar (e.g. a higher
+// resolution one): tile positions, source positions and seams are then scaled
+// by the size ratio, and the output size scales accordingly.
+struct QuiltMap
+{
+    // receives output row y of mip level level, width pixels
+    using MipRowSink = std::function<void(int level, int y, const Vec3 *row, int width)>;
+
+    int tileWidth  = 0;
+    int tileHeight = 0;
+    int seamWidth  = 0;
+    int seamHeight = 0;
+
+    int targetWidth  = 0;
+    int targetHeight = 0;
+
+    int sourceWidth  = 0;
+    int sourceHeight = 0;
+
+    int tileCountX = 0;
+    int tileCountY = 0;
+
+    // with transformed candidates, the width of the column slot of each
+    // transformed source in the positions (see CandidateIndex); 0 otherwise
+    int slotWidth = 0;
+
+    // tileCountX * tileCountY positions in raster order
+    std::vector<agz::math::vec2i> sources;
+
+    // tileHeight (tileWidth) entries per tile: 1 + the last tile column (row)
+    // kept from the left (top) neighbour, 0 where the tile is kept entirely
+    std::vector<uint16_t> leftSeams;
+    std::vector<uint16_t> topSeams;
+
+    // output size when rendering with a source of the given size
+    agz::math::vec2i renderSize(int srcWidth, int srcHeight) const noexcept;
+
+    // renders output row y (of renderSize(source) rows) into row
+    void renderRow(const Texture<Vec3> &source, int y, Vec3 *row) const;
+
+    // renders row y of the output resampled to outputWidth x outputHeight,
+    // each output pixel taking the map pixel under its centre
+    void renderRow(
+        const Texture<Vec3> &source,
+        int                  outputWidth,
+        int                  outputHeight,
+        int                  y,
+        Vec3                *row) const;
+
+    Texture<Vec3> render(const Texture<Vec3> &source) const;
+
+    // Renders the output mip chain directly from a source pyramid: level l
+    // has size max(1, size >> l), size being the renderSize of level 0, and
+    // takes its pixels from sourceLevels.level(l). Each output pixel belongs
+    // to the tile owning the map pixel under its centre, so only pixels along
+    // seams differ from filtering the full output. Chunks of rows of all levels are rendered on
+    // threadCount threads and passed to sink from one thread at a time, level
+    // by level in row order, so memory stays bounded by the chunks in flight.
+    void renderMipLevels(
+        const MipPyramid &sourceLevels,
+        int               threadCount,
+        const MipRowSink &sink) const;
+
+    std::vector<Texture<Vec3>> renderMipChain(
+        const MipPyramid &sourceLevels,
+        int               threadCount) const;
+
+    void write(std::ostream &out) const;
+
+    static QuiltMap read(std::istream &in);
+
+    void save(const std::string &filename) const;
+
+    static QuiltMap load(const std::string &filename);
+};
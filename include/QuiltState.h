@@ -0,0 +1,62 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <agz-utils/texture.h>
+
+// Choice made for one tile, together with what the coherence and PatchMatch
+// searches of its neighbours read from it.
+struct QuiltTileRecord
+{
+    agz::math::vec2i source = { -1, -1 };
+
+    // best overlap error of the full search this tile's choice descends from
+    float referenceMSE = 0;
+
+    agz::math::vec2i bestCandidate = { -1, -1 };
+    float            bestMSE = 0;
+    int              evaluatedCandidates = 0;
+
+    std::vector<agz::math::vec2i> goodCandidates;
+
+    // seams cut against the left and top neighbours: per tile row (column)
+    // the last column (row) kept from the neighbour; empty without that
+    // neighbour or without min cut. Recomputed on replay, so not serialized.
+    std::vector<int> leftSeam;
+    std::vector<int> topSeam;
+};
+
+// Tile grid, per-tile choices and seed of a quiltTexture call. Enough to
+// render the same texture again without any search, or to extend it with
+// TextureQuilter::extendTexture.
+struct QuiltState
+{
+    int tileWidth  = 0;
+    int tileHeight = 0;
+    int seamWidth  = 0;
+    int seamHeight = 0;
+
+    unsigned seed = 0;
+
+    int targetWidth  = 0;
+    int targetHeight = 0;
+
+    int tileCountX = 0;
+    int tileCountY = 0;
+
+    // tileCountX * tileCountY records in raster order
+    std::vector<QuiltTileRecord> tiles;
+
+    const QuiltTileRecord &tile(int tileX, int tileY) const { return tiles[tileY * tileCountX + tileX]; }
+
+    // plain text; floats are written with enough digits to read back exactly
+    void write(std::ostream &out) const;
+
+    static QuiltState read(std::istream &in);
+
+    void save(const std::string &filename) const;
+
+    static QuiltState load(const std::string &filename);
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include "PerfEventCounter.h"
+
+// Per-stage timers and counters of TextureQuilter::quiltTexture.
+//
+// Instrumentation points use the QUILT_STATS_* macros below, which expand to
+// nothing unless IMAGE_QUILTING_STATS is defined (see the CMake option of the
+// same name).
+struct QuiltStats
+{
+    std::atomic<uint64_t> totalNs     = 0;
+    std::atomic<uint64_t> scoringNs   = 0;
+    std::atomic<uint64_t> selectionNs = 0;
+    std::atomic<uint64_t> seamNs      = 0;
+
+    // copying tile pixels into the target, without the seam DP of seamNs
+    std::atomic<uint64_t> placementNs = 0;
+
+    std::atomic<uint64_t> tilesPlaced         = 0;
+    std::atomic<uint64_t> candidatesEvaluated = 0;
+    std::atomic<uint64_t> candidatesPruned    = 0;
+    std::atomic<uint64_t> coherentSelections  = 0;
+    std::atomic<uint64_t> toleranceBandSum    = 0;
+    std::atomic<uint64_t> toleranceBandMax    = 0;
+
+    // bytes of the working buffers and of the candidate maps' nodes, as
+    // requested from the allocator
+    std::atomic<uint64_t> bytesAllocated      = 0;
+
+    // 0 when hardware counters are unavailable, see PerfEventCounter
+    std::atomic<uint64_t> dtlbLoads      = 0;
+    std::atomic<uint64_t> dtlbLoadMisses = 0;
+
+    void reset() noexcept;
+
+    void writeJSON(std::ostream &out) const;
+
+    void writeCSV(std::ostream &out) const;
+};
+
+class ScopedStatsTimer
+{
+public:
+
+    explicit ScopedStatsTimer(std::atomic<uint64_t> &counter) noexcept
+        : counter_(counter), start_(std::chrono::steady_clock::now())
+    {
+
+    }
+
+    ~ScopedStatsTimer()
+    {
+        const auto end = std::chrono::steady_clock::now();
+        counter_.fetch_add(
+            static_cast<uint64_t>(std::chrono::duration_cast<
+                std::chrono::nanoseconds>(end - start_).count()),
+            std::memory_order_relaxed);
+    }
+
+    ScopedStatsTimer(const ScopedStatsTimer &) = delete;
+    ScopedStatsTimer &operator=(const ScopedStatsTimer &) = delete;
+
+private:
+
+    std::atomic<uint64_t>                 &counter_;
+    std::chrono::steady_clock::time_point  start_;
+};
+
+QuiltStats &quiltStats() noexcept;
+
+// Adds the dTLB loads and load misses of its scope, including the threads
+// started meanwhile, to quiltStats().
+class ScopedTLBStats
+{
+public:
+
+    ScopedTLBStats() noexcept
+        : loads_(PerfEventCounter::Event::DTLBLoads),
+          misses_(PerfEventCounter::Event::DTLBLoadMisses)
+    {
+        loads_.start();
+        misses_.start();
+    }
+
+    ~ScopedTLBStats()
+    {
+        quiltStats().dtlbLoadMisses.fetch_add(misses_.stop(), std::memory_order_relaxed);
+        quiltStats().dtlbLoads.fetch_add(loads_.stop(), std::memory_order_relaxed);
+    }
+
+    ScopedTLBStats(const ScopedTLBStats &) = delete;
+    ScopedTLBStats &operator=(const ScopedTLBStats &) = delete;
+
+private:
+
+    PerfEventCounter loads_;
+    PerfEventCounter misses_;
+};
+
+// Writes quiltStats() to the given file, as CSV when the file name ends with
+// ".csv" and as JSON otherwise.
+void saveQuiltStats(const std::string &filename);
+
+void updateMaxStat(std::atomic<uint64_t> &counter, uint64_t value) noexcept;
+
+#ifdef IMAGE_QUILTING_STATS
+
+#define QUILT_STATS_ENABLED 1
+
+#define QUILT_STATS_CONCAT_IMPL(A, B) A##B
+#define QUILT_STATS_CONCAT(A, B) QUILT_STATS_CONCAT_IMPL(A, B)
+
+#define QUILT_STATS_TIMER(STAGE) \
+    ScopedStatsTimer QUILT_STATS_CONCAT(quiltStatsTimer, __LINE__)( \
+        quiltStats().STAGE##Ns)
+
+#define QUILT_STATS_ADD(COUNTER, VALUE) \
+    quiltStats().COUNTER.fetch_add( \
+        static_cast<uint64_t>(VALUE), std::memory_order_relaxed)
+
+#define QUILT_STATS_MAX(COUNTER, VALUE) \
+    updateMaxStat(quiltStats().COUNTER, static_cast<uint64_t>(VALUE))
+
+#define QUILT_STATS_RESET() quiltStats().reset()
+
+#define QUILT_STATS_TLB() ScopedTLBStats quiltStatsTLB
+
+#else
+
+#define QUILT_STATS_ENABLED 0
+
+#define QUILT_STATS_TIMER(STAGE)         ((void)0)
+#define QUILT_STATS_ADD(COUNTER, VALUE)  ((void)0)
+#define QUILT_STATS_MAX(COUNTER, VALUE)  ((void)0)
+#define QUILT_STATS_RESET()              ((void)0)
+#define QUILT_STATS_TLB()                ((void)0)
+
+#endif
+
+// Standard allocator adding the bytes it allocates to
+// quiltStats().bytesAllocated in stats builds, for node-based containers
+// whose allocations are not visible otherwise.
+template<typename T>
+class StatsCountingAllocator
+{
+public:
+
+    using value_type = T;
+
+    StatsCountingAllocator() noexcept = default;
+
+    template<typename U>
+    StatsCountingAllocator(const StatsCountingAllocator<U> &) noexcept
+    {
+
+    }
+
+    T *allocate(size_t n)
+    {
+        QUILT_STATS_ADD(bytesAllocated, n * sizeof(T));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, size_t n) noexcept
+    {
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template<typename U>
+    bool operator==(const StatsCountingAllocator<U> &) const noexcept { return true; }
+
+    template<typename U>
+    bool operator!=(const StatsCountingAllocator<U> &) const noexcept { return false; }
+};
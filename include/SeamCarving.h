@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <agz-utils/texture.h>
+#include "BlockedTexture.h"
+#include "DihedralTransform.h"
 
 using Vec3 = agz::math::float3;
 
@@ -17,16 +19,22 @@ struct MinCostCutData
     int lastOffset = 0;
 };
 
+// The seam keeps A's pixels up to and including seam[i], B's after it.
+// Instantiated for (Texture<Vec3>, TextureView<Vec3>),
+// (BlockedTexture<Vec3>, BlockedTextureView<Vec3>), both textures with
+// DihedralTileView of them, and all of these pairs swapped.
+template<typename TextureA, typename TextureB>
 std::vector<int> findVerticalMinCostSeam(
-    const Texture<Vec3>     &A,
-    const TextureView<Vec3> &B,
+    const TextureA &A,
+    const TextureB &B,
     int xA,    int yA,
     int xB,    int yB,
     int width, int height);
 
+template<typename TextureA, typename TextureB>
 std::vector<int> findHorizontalMinCostSeam(
-    const Texture<Vec3>     &A,
-    const TextureView<Vec3> &B,
+    const TextureA &A,
+    const TextureB &B,
     int xA,    int yA,
     int xB,    int yB,
     int width, int height);
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vector>
+#include <agz-utils/texture.h>
+#include "DihedralTransform.h"
+
+using Vec3 = agz::math::float3;
+
+template<typename T>
+using Texture = agz::texture::texture2d_t<T>;
+
+// Several exemplars packed into one texture, so that quilting from all of them
+// shares one source with one set of luminance statistics and replicas. The
+// exemplars are placed on shelves in order of decreasing height; texels
+// outside them are black and never part of a candidate tile.
+class SourceAtlas
+{
+public:
+
+    struct Placement
+    {
+        int x      = 0;
+        int y      = 0;
+        int width  = 0;
+        int height = 0;
+    };
+
+    explicit SourceAtlas(const std::vector<Texture<Vec3>> &sources);
+
+    const Texture<Vec3> &texture() const noexcept { return texture_; }
+
+    int sourceCount() const noexcept { return static_cast<int>(placements_.size()); }
+
+    // where sources[index] lies in texture()
+    const Placement &placement(int index) const noexcept { return placements_[index]; }
+
+private:
+
+    Texture<Vec3> texture_;
+
+    std::vector<Placement> placements_;
+};
+
+// Candidate tile positions of a source for one tile size: per exemplar the
+// rectangle of positions whose tile lies inside it, x in
+// [range.x, range.x + range.width) and likewise for y. The positions are
+// numbered range by range, row-major inside a range, so that all exemplars are
+// searched and sampled through a single index.
+//
+// With transforms, the candidates also include the tiles of the seven other
+// rotations and mirrors of the source. Transformed source t occupies the
+// columns [t * slotWidth(), (t + 1) * slotWidth()) of the position space, so
+// a position still identifies a candidate by itself; the identity keeps the
+// source's own positions.
+class CandidateIndex
+{
+public:
+
+    struct Range
+    {
+        int x      = 0;
+        int y      = 0;
+        int width  = 0;
+        int height = 0;
+
+        // index of the range's first position
+        long long firstIndex = 0;
+
+        int transform = 0;
+    };
+
+    // a position of the index resolved to its transformed source
+    struct Candidate
+    {
+        const DihedralTransform *transform = nullptr;
+
+        // tile position in the transformed source
+        agz::math::vec2i position;
+    };
+
+    // the whole source as a single exemplar
+    CandidateIndex(
+        int  sourceWidth,
+        int  sourceHeight,
+        int  tileWidth,
+        int  tileHeight,
+        bool transforms = false);
+
+    CandidateIndex(
+        const SourceAtlas &atlas,
+        int                tileWidth,
+        int                tileHeight,
+        bool               transforms = false);
+
+    const std::vector<Range> &ranges() const noexcept { return ranges_; }
+
+    long long size() const noexcept { return size_; }
+
+    agz::math::vec2i operator[](long long index) const noexcept;
+
+    // index of the range holding position xy, -1 when it is no candidate
+    int rangeOf(agz::math::vec2i xy) const noexcept;
+
+    bool contains(agz::math::vec2i xy) const noexcept { return rangeOf(xy) >= 0; }
+
+    // nearest position of the given range
+    agz::math::vec2i clamp(agz::math::vec2i xy, int range) const noexcept;
+
+    // 0 without transforms
+    int slotWidth() const noexcept { return slotWidth_; }
+
+    Candidate resolve(agz::math::vec2i xy) const noexcept
+    {
+        const int t = slotWidth_ ? xy.x / slotWidth_ : 0;
+        return { &transforms_[t], { xy.x - t * slotWidth_, xy.y } };
+    }
+
+private:
+
+    void initializeTransforms(int sourceWidth, int sourceHeight, bool transforms);
+
+    void addRange(int x, int y, int width, int height, int transform);
+
+    std::vector<Range> ranges_;
+
+    long long size_ = 0;
+
+    int slotWidth_ = 0;
+
+    std::vector<DihedralTransform> transforms_;
+};
@@ -1,9 +1,23 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <optional>
 #include <random>
+#include <string>
+#include <map>
 #include <agz-utils/texture.h>
+#include "BlockedTexture.h"
 #include "SeamCarving.h"
 #include "ErrorMetrics.h"
+#include "FFT.h"
+#include "LuminanceStatistics.h"
+#include "ProgressReporter.h"
+#include "QuiltStats.h"
+#include "QuiltMap.h"
+#include "QuiltState.h"
+#include "SourceAtlas.h"
+#include "TraceRecorder.h"
 
 using Vec3 = agz::math::float3;
 
@@ -13,6 +27,73 @@ using Texture = agz::texture::texture2d_t<T>;
 template<typename T>
 using TextureView = agz::texture::texture2d_view_t<T, true>;
 
+enum class SearchMode
+{
+    Exhaustive,
+    Stochastic,
+    PatchMatch,
+    Strided,
+};
+
+struct StochasticSearchParams
+{
+    // number of sampled source positions; when 0, sampleFraction of all of them
+    int   sampleCount    = 0;
+    float sampleFraction = 0.05f;
+
+    // R2 low-discrepancy sequence with a random offset instead of uniform samples
+    bool lowDiscrepancy = true;
+
+    // densely rescore the (2 * refineRadius + 1)^2 window around each of the
+    // refineCount best samples
+    int refineCount  = 4;
+    int refineRadius = 2;
+};
+
+// PatchMatch (Barnes et al. 2009) over the tile grid: propagate the best
+// source offsets of already placed neighbours, then search randomly around the
+// best one at radii shrinking by radiusRatio.
+struct PatchMatchParams
+{
+    int   randomInitCount = 8;
+    int   iterations      = 4;
+    float radiusRatio     = 0.5f;
+};
+
+// Scores every stride-th source position in both directions, then every
+// position of the stride x stride windows centred on the refineCount best grid
+// points. stride 0 picks it from the tile size (4 for 64px tiles).
+struct StridedSearchParams
+{
+    int stride      = 0;
+    int refineCount = 4;
+};
+
+// Texture transfer (Efros & Freeman 2001): candidates are scored by
+// alpha * overlap error + (1 - alpha) * correspondence error, the latter
+// between the blurred luminance of the candidate and of the guide under the
+// tile. Pass i of passes uses tiles (2/3)^i the configured size (seams scaled
+// alike) and an alpha rising linearly from alpha to 0.9; from the second
+// pass on, the overlap error also includes the error against the previous
+// pass's output under the whole tile.
+struct TransferParams
+{
+    float alpha      = 0.1f;
+    int   passes     = 1;
+
+    // radius of the box blur applied to source and guide luminance
+    int   blurRadius = 2;
+};
+
+// Overlap errors of the best candidates found, for trading speed for quality.
+struct QuiltQuality
+{
+    float meanBestMSE  = 0;
+    float worstBestMSE = 0;
+
+    long long evaluatedCandidates = 0;
+};
+
 class TextureQuilter
 {
 public:
@@ -32,25 +113,496 @@ public:
 
     void enableMinCut(bool enable) noexcept;
 
+    // score candidates from precomputed luminance statistics instead of
+    // rereading the float3 overlap of every candidate
+    void enableFastMetric(bool enable) noexcept;
+
+    // score candidates on int16 fixed-point luminance with integer SIMD; meant
+    // for 8-bit sources, whose luminance it represents without loss of ranking.
+    // Takes precedence over the fast metric.
+    void enableFixedPointMetric(bool enable) noexcept;
+
+    // keep source and target in 32x32 pixel blocks during synthesis, so that
+    // tile placement and overlap scans touch few pages per tile
+    void enableBlockedStorage(bool enable) noexcept;
+
+    // also consider the tiles of the source rotated by 90, 180 and 270
+    // degrees and of its mirrors, read by index remapping without copying
+    // the source. Not used by quiltMaskedRegion, LazyQuilter and
+    // transferTexture.
+    void enableTransformedCandidates(bool enable) noexcept;
+
+    // make quiltTexture output tile seamlessly: the last column and row of
+    // tiles also overlap the first ones across the wrap-around and are cut
+    // in with seams on both sides. The output size is rounded to a multiple
+    // of the tile steps (tile size minus seam size), at least two of them.
+    // Not supported with states and maps; not used by quiltMaskedRegion,
+    // LazyQuilter and transferTexture.
+    void enableToroidal(bool enable) noexcept;
+
+    // first score the source positions continuing the left and top
+    // neighbours' choices and up to cachedCandidates of their best
+    // candidates; fall back to the full search only when none of them lies
+    // within the neighbours' tolerance band. 0 disables coherence search.
+    void enableCoherenceSearch(int cachedCandidates) noexcept;
+
+    void setSearchMode(SearchMode mode) noexcept;
+
+    void setStochasticSearchParams(const StochasticSearchParams &params) noexcept;
+
+    void setPatchMatchParams(const PatchMatchParams &params) noexcept;
+
+    void setStridedSearchParams(const StridedSearchParams &params) noexcept;
+
+    // number of threads placing tiles along the wavefront, see TileScheduler;
+    // 0 uses all hardware threads. Tiles are placed sequentially unless
+    // tileWidth >= 2 * seamWidth and tileHeight >= 2 * seamHeight.
+    void setThreadCount(int threadCount) noexcept;
+
+    // pin the threads to the CPUs of all NUMA nodes, replicate the source on
+    // every node and let each node's threads first-touch their band of the
+    // target; has no effect when tiles are placed sequentially
+    void enableNUMA(bool enable) noexcept;
+
+    // seeds the per-tile random engines, which makes the result independent
+    // of the thread count; without a seed every call draws a new one
+    void setSeed(unsigned seed) noexcept;
+
+    // when non-empty, quiltTexture writes a Chrome trace of the per-tile
+    // select/seam/place events to this file; transferTexture writes the
+    // events of all its passes, tagged with the pass
+    void setTraceFile(std::string filename);
+
+    // defaults to a TTYProgressReporter of each call's own, so that copies of
+    // a quilter may run concurrently; nullptr disables progress reporting.
+    // A reporter set here is shared by copies of the quilter, and must
+    // synchronize itself when they run concurrently.
+    void setProgressReporter(std::shared_ptr<ProgressReporter> reporter);
+
+    // receives row y of the output of quiltTexture/extendTexture as soon as
+    // every tile overlapping it is placed, while later tile rows are still
+    // being synthesized; rows arrive in order, one at a time, on the worker
+    // threads. Not used by transferTexture.
+    using RowSink = std::function<void(int y, const Vec3 *row, int width)>;
+
+    void setRowSink(RowSink sink);
+
+    // width and height of the output of quiltTexture for this target size,
+    // which differ from it with toroidal quilting
+    std::pair<int, int> outputSize(int targetWidth, int targetHeight) const noexcept;
+
+    // state, when not null, receives the tile grid and choices of the result;
+    // map, when not null, its source positions and seams for re-rendering
     Texture<Vec3> quiltTexture(
         const Texture<Vec3> &source,
         int                  targetWidth,
-        int                  targetHeight) const;
+        int                  targetHeight,
+        QuiltQuality        *quality = nullptr,
+        QuiltState          *state   = nullptr,
+        QuiltMap            *map     = nullptr) const;
+
+    // Quilts from all exemplars of sources. Candidates are the positions of
+    // sources.texture() whose tile lies inside a single exemplar, scanned and
+    // sampled through one CandidateIndex; with the stochastic and PatchMatch
+    // search modes a tile therefore costs the same however many exemplars
+    // there are. state and map refer to positions in sources.texture().
+    Texture<Vec3> quiltTexture(
+        const SourceAtlas &sources,
+        int                targetWidth,
+        int                targetHeight,
+        QuiltQuality      *quality = nullptr,
+        QuiltState        *state   = nullptr,
+        QuiltMap          *map     = nullptr) const;
+
+    // Grows the texture described by previous to targetWidth x targetHeight
+    // so that the result equals a single quiltTexture call of that size with
+    // previous.seed. The tile parameters must equal previous' and the other
+    // settings must match the ones it was quilted with. Previous tiles are
+    // re-rendered from their recorded sources without search; only new tiles
+    // are searched, plus, when columns are added, the previous tiles whose
+    // top-right neighbour is new and the tiles depending on them.
+    Texture<Vec3> extendTexture(
+        const Texture<Vec3> &source,
+        const QuiltState    &previous,
+        int                  targetWidth,
+        int                  targetHeight,
+        QuiltQuality        *quality = nullptr,
+        QuiltState          *state   = nullptr,
+        QuiltMap            *map     = nullptr) const;
+
+    Texture<Vec3> extendTexture(
+        const SourceAtlas &sources,
+        const QuiltState  &previous,
+        int                targetWidth,
+        int                targetHeight,
+        QuiltQuality      *quality = nullptr,
+        QuiltState        *state   = nullptr,
+        QuiltMap          *map     = nullptr) const;
+
+    // Synthesizes a texture of guide's size that follows guide, see
+    // TransferParams. The whole-tile terms are computed for all candidates of
+    // a tile at once by FFT cross-correlation, and the squared sums come from
+    // summed-area tables, so a tile costs little more than with plain
+    // quilting. Always uses MSE selection; quality describes the last pass.
+    Texture<Vec3> transferTexture(
+        const Texture<Vec3>  &source,
+        const Texture<Vec3>  &guide,
+        const TransferParams &params,
+        QuiltQuality         *quality = nullptr) const;
+
+    // Re-quilts only the tiles of target's tile grid that intersect mask
+    // (texels > 0.5), matching each against the surrounding pixels on all
+    // four sides and cutting seams towards every kept or already re-quilted
+    // neighbour. The search cost is proportional to the number of those
+    // tiles. mask must have target's size, which must hold at least one tile.
+    Texture<Vec3> quiltMaskedRegion(
+        const Texture<Vec3>  &source,
+        const Texture<Vec3>  &target,
+        const Texture<float> &mask) const;
 
 private:
 
-    TextureView<Vec3> selectSourceTile(
-        const Texture<Vec3>        &source,
-        const Texture<Vec3>        &target,
+    friend class LazyQuilter;
+
+    using CandidateMap = std::multimap<
+        float, agz::math::vec2i, std::less<float>,
+        StatsCountingAllocator<std::pair<const float, agz::math::vec2i>>>;
+
+    using TileRecord = QuiltTileRecord;
+
+    // data of one transferTexture pass shared by all tiles
+    struct TransferPass
+    {
+        float alpha = 1;
+
+        // blurred guide luminance, of guide's size
+        const LuminancePlane *guideLum = nullptr;
+
+        // luminance of the previous pass's output, nullptr in the first pass
+        const LuminancePlane *previousLum = nullptr;
+
+        const SourceStatistics *blurredSource           = nullptr;
+        const PlaneCorrelator  *blurredSourceCorrelator = nullptr;
+
+        const SourceStatistics *source           = nullptr;
+        const PlaneCorrelator  *sourceCorrelator = nullptr;
+    };
+
+    // source-side data read by candidate scoring, one per NUMA node
+    struct SourceReplica
+    {
+        const Texture<Vec3> *texture = nullptr;
+
+        // node-local copy texture points to, when replicated
+        Texture<Vec3> copy;
+
+        std::optional<SourceStatistics>         stats;
+        std::optional<LuminancePlane>           luminance;
+        std::optional<FixedPointLuminancePlane> fixedPoint;
+        std::optional<BlockedTexture<Vec3>>     blocked;
+    };
+
+    // view of the state of one quiltTexture call, with the source replica of
+    // the node the current thread runs on
+    struct QuiltContext
+    {
+        const Texture<Vec3> *source = nullptr;
+        Texture<Vec3>       *target = nullptr;
+
+        const SourceStatistics *sourceStats = nullptr;
+        TargetStatistics       *targetStats = nullptr;
+
+        const FixedPointLuminancePlane *sourceFixedPoint = nullptr;
+        FixedPointLuminancePlane       *targetFixedPoint = nullptr;
+
+        const BlockedTexture<Vec3> *blockedSource = nullptr;
+        BlockedTexture<Vec3>       *blockedTarget = nullptr;
+
+        // source luminance read by transformed candidates
+        const LuminancePlane *sourceLuminance = nullptr;
+
+        const CandidateIndex *candidates = nullptr;
+
+        int tileCountX = 0;
+        int tileCountY = 0;
+        TileRecord *tiles = nullptr;
+
+        // toroidal mode: the output repeats every periodWidth x periodHeight
+        // target pixels, 0 otherwise
+        int periodWidth  = 0;
+        int periodHeight = 0;
+
+        // transfer mode: the weighted whole-tile error of every candidate of
+        // the current tile, added to overlapWeight * overlap error
+        const float *transferError  = nullptr;
+        int          transferStride = 0;
+        float        overlapWeight  = 1;
+
+        // fast metric: squared target luminance of the current tile's overlap
+        // strips, which every candidate is compared against, so they are
+        // summed once per tile; the right and bottom ones of toroidal tiles
+        TargetOverlapSums targetOverlap;
+        double            targetRightSum  = 0;
+        double            targetBottomSum = 0;
+
+        void useSource(const SourceReplica &replica) noexcept
+        {
+            source           = replica.texture;
+            sourceStats      = replica.stats      ? &*replica.stats      : nullptr;
+            sourceFixedPoint = replica.fixedPoint ? &*replica.fixedPoint : nullptr;
+            blockedSource    = replica.blocked    ? &*replica.blocked    : nullptr;
+            sourceLuminance  = replica.luminance  ? &*replica.luminance  :
+                               replica.stats      ? &replica.stats->luminance() : nullptr;
+        }
+
+        bool wrapsRight(int x, int tileWidth) const noexcept
+        {
+            return periodWidth > 0 && x + tileWidth > periodWidth;
+        }
+
+        bool wrapsBottom(int y, int tileHeight) const noexcept
+        {
+            return periodHeight > 0 && y + tileHeight > periodHeight;
+        }
+
+        TileRecord &tile(int tileX, int tileY) { return tiles[tileY * tileCountX + tileX]; }
+
+        const TileRecord &tile(int tileX, int tileY) const { return tiles[tileY * tileCountX + tileX]; }
+    };
+
+    // atlas, when not null, holds source and restricts candidates to its
+    // exemplars
+    Texture<Vec3> synthesize(
+        const Texture<Vec3> &source,
+        const SourceAtlas   *atlas,
+        int                  targetWidth,
+        int                  targetHeight,
+        unsigned             seed,
+        const QuiltState    *previous,
+        QuiltQuality        *quality,
+        QuiltState          *state,
+        QuiltMap            *map,
+        const TransferPass  *transfer) const;
+
+    void validateExtension(
+        const QuiltState &previous,
+        int               targetWidth,
+        int               targetHeight) const;
+
+    // (1 - alpha) * correspondence error, plus alpha * the error against the
+    // previous output, of every candidate for the tile at (x, y)
+    void computeTransferError(
+        const TransferPass &transfer,
+        int                 x,
+        int                 y,
+        std::vector<float> &error) const;
+
+    // fills the target sums of ctx for the tile at (x, y)
+    void computeTargetOverlapSums(
+        QuiltContext &ctx,
+        int           x,
+        int           y) const;
+
+    void initializeSourceReplica(
+        SourceReplica       &replica,
+        const Texture<Vec3> &source,
+        bool                 copy) const;
+
+    float scoreOverlap(
+        const QuiltContext &ctx,
+        int                 srcX,
+        int                 srcY,
+        int                 x,
+        int                 y) const;
+
+    // scoreOverlap of a candidate of a rotated or mirrored source
+    float scoreTransformedOverlap(
+        const QuiltContext              &ctx,
+        const CandidateIndex::Candidate &candidate,
+        int                              x,
+        int                              y) const;
+
+    // overlap error of a tile in the last column or row of a toroidal grid:
+    // the error of the left and top strips (overlapError, as computed by
+    // scoreOverlap) extended by the right and bottom strips
+    float scoreWrappedOverlap(
+        const QuiltContext &ctx,
+        float               overlapError,
+        int                 srcX,
+        int                 srcY,
+        int                 x,
+        int                 y) const;
+
+    // squared error sum between the width x height rectangle at (offsetX,
+    // offsetY) of the candidate tile and the target under it; targetSum is
+    // the fast metric's squared target luminance of the rectangle
+    float scoreOverlapRegion(
+        const QuiltContext              &ctx,
+        const CandidateIndex::Candidate &candidate,
+        int                              offsetX,
+        int                              offsetY,
+        int                              width,
+        int                              height,
+        int                              x,
+        int                              y,
+        double                           targetSum) const;
+
+    float blendTransferError(
+        const QuiltContext &ctx,
+        float               overlapError,
+        int                 srcX,
+        int                 srcY) const noexcept
+    {
+        if(!ctx.transferError)
+            return overlapError;
+        return ctx.overlapWeight * overlapError + ctx.transferError[srcY * ctx.transferStride + srcX];
+    }
+
+    float scoreCandidate(
+        const QuiltContext &ctx,
+        int                 srcX,
+        int                 srcY,
+        int                 x,
+        int                 y) const;
+
+    void addCandidate(
+        CandidateMap     &mseToXY,
+        float             mse,
+        agz::math::vec2i  xy,
+        int               x,
+        int               y) const;
+
+    int scanAllCandidates(
+        const QuiltContext &ctx,
+        int                 x,
+        int                 y,
+        CandidateMap       &mseToXY) const;
+
+    int scanStochasticCandidates(
+        const QuiltContext         &ctx,
         int                         x,
         int                         y,
+        std::default_random_engine &rng,
+        CandidateMap               &mseToXY) const;
+
+    int scanStridedCandidates(
+        const QuiltContext &ctx,
+        int                 x,
+        int                 y,
+        CandidateMap       &mseToXY) const;
+
+    int scanPatchMatchCandidates(
+        const QuiltContext         &ctx,
+        int                         tileX,
+        int                         tileY,
+        std::default_random_engine &rng,
+        CandidateMap               &mseToXY) const;
+
+    int scanCandidates(
+        const QuiltContext         &ctx,
+        int                         tileX,
+        int                         tileY,
+        std::default_random_engine &rng,
+        CandidateMap               &mseToXY) const;
+
+    int scanCoherentCandidates(
+        const QuiltContext &ctx,
+        int                 tileX,
+        int                 tileY,
+        CandidateMap       &mseToXY,
+        float              &referenceMSE) const;
+
+    agz::math::vec2i pickFromToleranceBand(
+        const CandidateMap         &mseToXY,
+        int                         evaluatedCount,
         std::default_random_engine &rng) const;
 
+    agz::math::vec2i selectSourceTile(
+        QuiltContext               &ctx,
+        int                         tileX,
+        int                         tileY,
+        std::default_random_engine &rng) const;
+
+    struct ConstrainedTile
+    {
+        int x = 0;
+        int y = 0;
+
+        // sides whose overlap band holds pixels to match
+        bool left   = false;
+        bool top    = false;
+        bool right  = false;
+        bool bottom = false;
+
+        // (tile pixel index, luminance before re-quilting) of masked pixels
+        std::vector<std::pair<int, float>> maskedLum;
+    };
+
+    agz::math::vec2i selectConstrainedSourceTile(
+        const Texture<Vec3>        &source,
+        const LuminancePlane       &sourceLum,
+        const Texture<Vec3>        &target,
+        const ConstrainedTile      &constrained,
+        std::default_random_engine &rng) const;
+
+    // coverage, when not null, receives tileWidth * tileHeight flags of the
+    // tile pixels written
+    void placeConstrainedTile(
+        const Texture<Vec3>   &source,
+        Texture<Vec3>         &target,
+        agz::math::vec2i       xy,
+        const ConstrainedTile &constrained,
+        std::vector<char>     *coverage = nullptr) const;
+
+    // places record.source and stores the seams cut in record
+    void placeSelectedTile(
+        QuiltContext &ctx,
+        TileRecord   &record,
+        int           x,
+        int           y) const;
+
+    // TileView/TargetTexture are TextureView/Texture or their blocked
+    // variants. wrapRight/wrapBottom also cut the tile's right/bottom
+    // overlap band into the target, whose seams are not recorded.
+    template<typename TileView, typename TargetTexture>
     void placeTile(
-        const TextureView<Vec3> &tile,
-        Texture<Vec3>           &target,
-        int                      x,
-        int                      y) const;
+        const TileView &tile,
+        TargetTexture  &target,
+        int             x,
+        int             y,
+        TileRecord     &record,
+        bool            wrapRight,
+        bool            wrapBottom) const;
+
+    // Toroidal mode keeps the overlap bands across the wrap-around twice:
+    // at the start of the target, where the first column/row of tiles
+    // places them, and past its period, where the last column/row matches
+    // and cuts into them. copyWrapBands copies what the tile at (tileX,
+    // tileY) placed in the first column/row to the band past the period,
+    // and tile (tileCountX - 1, 0) also copies the top-right corner of the
+    // period to the bottom-left, where tile (0, tileCountY - 1) reads it.
+    void copyWrapBands(
+        QuiltContext &ctx,
+        int           tileX,
+        int           tileY) const;
+
+    // Before the tile (tileCountX - 1, tileY) is searched: cuts the pixels
+    // of the tile (0, tileY) below its top seam into the band past the
+    // period, where tile (tileCountX - 1, tileY - 1) placed the pixels above
+    void mergeWrapBand(
+        QuiltContext &ctx,
+        int           tileY) const;
+
+    // copies the width x height rectangle at (fromX, fromY) of the target
+    // to (toX, toY) and updates the target metric planes
+    void copyTargetRegion(
+        QuiltContext &ctx,
+        int           fromX,
+        int           fromY,
+        int           toX,
+        int           toY,
+        int           width,
+        int           height) const;
 
     int tileWidth_;
     int tileHeight_;
@@ -61,4 +613,30 @@ private:
 
     bool enableMSESelection_;
     bool enableMinCut_;
+    bool enableFastMetric_;
+    bool enableFixedPointMetric_;
+    bool enableBlockedStorage_;
+    bool enableTransforms_;
+    bool toroidal_;
+
+    int coherenceCandidates_;
+
+    int  threadCount_;
+    bool enableNUMA_;
+
+    std::optional<unsigned> seed_;
+
+    SearchMode             searchMode_;
+    StochasticSearchParams stochasticParams_;
+    PatchMatchParams       patchMatchParams_;
+    StridedSearchParams    stridedParams_;
+
+    std::string                    traceFile_;
+    std::shared_ptr<TraceRecorder> traceRecorder_;
+
+    // unused while ttyProgress_, which stands for the default
+    std::shared_ptr<ProgressReporter> progressReporter_;
+    bool                              ttyProgress_;
+
+    RowSink rowSink_;
 };
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "NUMATopology.h"
+
+// Runs one task per tile of a tile grid on a pool of threads, following the
+// quilting wavefront: tile (x, y) starts once (x - 1, y), (x, y - 1) and
+// (x + 1, y - 1) are done. As long as tiles only overlap their 8 neighbours,
+// every tile overlapping a running one is then either done or waiting for it.
+//
+// With a topology, workers are pinned to CPUs spread round-robin over the
+// nodes (only over the first threadCount nodes when there are fewer workers
+// than nodes), and each node's workers preferably run the tiles of its band
+// of rows.
+class TileScheduler
+{
+public:
+
+    struct Worker
+    {
+        int index    = 0;
+        int node     = 0;
+
+        // index among the workers of the same node
+        int nodeRank = 0;
+    };
+
+    using TileTask = std::function<void(int tileX, int tileY, const Worker &worker)>;
+
+    // threadCount <= 1 runs the tiles in raster order on the calling thread,
+    // which is never pinned. topology may be nullptr, in which case all
+    // workers belong to node 0 and are not pinned.
+    TileScheduler(int threadCount, const NUMATopology *topology);
+
+    int threadCount() const noexcept { return static_cast<int>(workers_.size()); }
+
+    int nodeCount() const noexcept { return nodeCount_; }
+
+    // called on every worker after pinning and before any tile runs, e.g.
+    // for first-touch initialization of node-local memory
+    void setWorkerInit(std::function<void(const Worker &)> init);
+
+    // node whose workers preferably run the tiles of the given row: rows are
+    // split into contiguous bands, one per node
+    int nodeOfRow(int tileY, int tileCountY) const noexcept;
+
+    // rethrows the first exception thrown by a task or a worker init. With
+    // wrapAround, tile (0, tileCountY - 1) also waits for
+    // (tileCountX - 1, 0), whose overlap with it wraps around the grid.
+    void run(
+        int             tileCountX,
+        int             tileCountY,
+        const TileTask &task,
+        bool            wrapAround = false);
+
+private:
+
+    void runSequential(int tileCountX, int tileCountY, const TileTask &task);
+
+    std::vector<Worker> workers_;
+    std::vector<int>    workerCPUs_;
+    int                 nodeCount_;
+
+    std::function<void(const Worker &)> workerInit_;
+};
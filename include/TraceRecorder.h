@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct TraceEvent
+{
+    const char *name = nullptr;
+    int x = 0;
+    int y = 0;
+    int pass = 0;
+    uint64_t beginNs = 0;
+    uint64_t endNs   = 0;
+};
+
+// Collects per-tile begin/end events into per-thread ring buffers and writes
+// them in the Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+//
+// Recording never locks after a thread's first event; when a ring buffer is
+// full the oldest events of that thread are overwritten.
+class TraceRecorder
+{
+public:
+
+    explicit TraceRecorder(size_t eventsPerThread = 1 << 16);
+
+    TraceRecorder(const TraceRecorder &) = delete;
+    TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+    uint64_t now() const noexcept;
+
+    void record(
+        const char *name, int x, int y,
+        uint64_t beginNs, uint64_t endNs);
+
+    // must not be called concurrently with record; also resets the pass
+    void clear();
+
+    // tags the events recorded from now on, e.g. with the pass of a texture
+    // transfer; must not be called concurrently with record
+    void setPass(int pass) noexcept;
+
+    void writeChromeTrace(std::ostream &out) const;
+
+    void save(const std::string &filename) const;
+
+private:
+
+    struct ThreadBuffer
+    {
+        int                     threadIndex = 0;
+        std::vector<TraceEvent> events;
+        uint64_t                written = 0;
+    };
+
+    ThreadBuffer &threadBuffer();
+
+    const uint64_t                        id_;
+    const size_t                          eventsPerThread_;
+    const std::chrono::steady_clock::time_point epoch_;
+
+    int pass_ = 0;
+
+    mutable std::mutex                          mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>>  buffers_;
+};
+
+// Records one complete event on destruction. A null recorder disables it.
+class ScopedTraceEvent
+{
+public:
+
+    ScopedTraceEvent(
+        TraceRecorder *recorder, const char *name, int x, int y) noexcept
+        : recorder_(recorder), name_(name), x_(x), y_(y),
+          beginNs_(recorder ? recorder->now() : 0)
+    {
+
+    }
+
+    ~ScopedTraceEvent()
+    {
+        if(recorder_)
+            recorder_->record(name_, x_, y_, beginNs_, recorder_->now());
+    }
+
+    ScopedTraceEvent(const ScopedTraceEvent &) = delete;
+    ScopedTraceEvent &operator=(const ScopedTraceEvent &) = delete;
+
+private:
+
+    TraceRecorder *recorder_;
+    const char    *name_;
+    int            x_;
+    int            y_;
+    uint64_t       beginNs_;
+};
@@ -0,0 +1,166 @@
+#include "../include/Deflate.h"
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+#include <zlib.h>
+
+namespace
+{
+    constexpr size_t WINDOW_SIZE = 32768;
+
+    // zlib takes lengths as uInt
+    constexpr size_t MAX_CHUNK = UINT_MAX;
+
+} // namespace anonymous
+
+uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size) noexcept
+{
+    uLong result = crc;
+    while(size > 0)
+    {
+        const size_t n = std::min(size, MAX_CHUNK);
+        result = ::crc32(result, data, static_cast<uInt>(n));
+        data += n;
+        size -= n;
+    }
+    return static_cast<uint32_t>(result);
+}
+
+uint32_t adler32(uint32_t adler, const uint8_t *data, size_t size) noexcept
+{
+    uLong result = adler;
+    while(size > 0)
+    {
+        const size_t n = std::min(size, MAX_CHUNK);
+        result = ::adler32(result, data, static_cast<uInt>(n));
+        data += n;
+        size -= n;
+    }
+    return static_cast<uint32_t>(result);
+}
+
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondSize) noexcept
+{
+    // only secondSize modulo 65521 matters
+    return static_cast<uint32_t>(adler32_combine(
+        first, second, static_cast<z_off_t>(secondSize % 65521)));
+}
+
+void writeZlibHeader(int level, std::vector<uint8_t> &out)
+{
+    // the level field is informational
+    level = std::clamp(level, 0, 9);
+    const int levelField = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+
+    const int cmf = 0x78;
+    int flg = levelField << 6;
+    flg += (31 - (cmf * 256 + flg) % 31) % 31;
+
+    out.push_back(static_cast<uint8_t>(cmf));
+    out.push_back(static_cast<uint8_t>(flg));
+}
+
+void deflateStrip(
+    const uint8_t        *data,
+    size_t                size,
+    const uint8_t        *dictionary,
+    size_t                dictionarySize,
+    int                   level,
+    bool                  final,
+    std::vector<uint8_t> &out)
+{
+    // only the last 32KB are within reach
+    if(dictionarySize > WINDOW_SIZE)
+    {
+        dictionary += dictionarySize - WINDOW_SIZE;
+        dictionarySize = WINDOW_SIZE;
+    }
+
+    if(size > MAX_CHUNK)
+        throw std::runtime_error("deflate strip too large");
+
+    z_stream stream = {};
+    if(deflateInit2(&stream, std::clamp(level, 0, 9), Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("failed to initialize zlib deflate");
+
+    if(dictionarySize)
+        deflateSetDictionary(&stream, dictionary, static_cast<uInt>(dictionarySize));
+
+    stream.next_in  = const_cast<Bytef *>(data);
+    stream.avail_in = static_cast<uInt>(size);
+
+    const int flush = final ? Z_FINISH : Z_SYNC_FLUSH;
+    size_t used = out.size();
+    int result;
+    do
+    {
+        out.resize(used + std::max<size_t>(deflateBound(&stream, static_cast<uLong>(size)), 1 << 16));
+        stream.next_out  = out.data() + used;
+        stream.avail_out = static_cast<uInt>(out.size() - used);
+        result = deflate(&stream, flush);
+        used = out.size() - stream.avail_out;
+    } while(result == Z_OK && stream.avail_out == 0);
+
+    out.resize(used);
+    deflateEnd(&stream);
+
+    if(result != (final ? Z_STREAM_END : Z_OK))
+        throw std::runtime_error("zlib deflate failed");
+}
+
+struct ZlibInflater::Stream
+{
+    z_stream stream   = {};
+    bool     finished = false;
+};
+
+ZlibInflater::ZlibInflater()
+    : stream_(std::make_unique<Stream>())
+{
+    if(inflateInit(&stream_->stream) != Z_OK)
+        throw std::runtime_error("failed to initialize zlib inflate");
+}
+
+ZlibInflater::~ZlibInflater()
+{
+    inflateEnd(&stream_->stream);
+}
+
+void ZlibInflater::feed(const uint8_t *data, size_t size)
+{
+    if(size > MAX_CHUNK)
+        throw std::runtime_error("inflate input too large");
+    stream_->stream.next_in  = const_cast<Bytef *>(data);
+    stream_->stream.avail_in = static_cast<uInt>(size);
+}
+
+bool ZlibInflater::needsInput() const noexcept
+{
+    return stream_->stream.avail_in == 0;
+}
+
+bool ZlibInflater::finished() const noexcept
+{
+    return stream_->finished;
+}
+
+size_t ZlibInflater::inflate(uint8_t *out, size_t size)
+{
+    if(stream_->finished || size == 0)
+        return 0;
+
+    z_stream &stream = stream_->stream;
+    stream.next_out  = out;
+    stream.avail_out = static_cast<uInt>(std::min(size, MAX_CHUNK));
+
+    const uInt available = stream.avail_out;
+    const int result = ::inflate(&stream, Z_NO_FLUSH);
+    if(result == Z_STREAM_END)
+        stream_->finished = true;
+    else if(result != Z_OK && result != Z_BUF_ERROR)
+        throw std::runtime_error("zlib inflate failed: corrupt data");
+
+    return available - stream.avail_out;
+}
@@ -2,6 +2,22 @@
 // Created by Salah Mezraoui on 30.08.24.
 //
 #include "../include/ErrorMetrics.h"
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define IMAGE_QUILTING_BATCH_SSE
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMAGE_QUILTING_FIXED_POINT_SSE2
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define IMAGE_QUILTING_FIXED_POINT_AVX2
+#endif
 
 float calculateErrorSum(
     const Texture<Vec3> &A, int xA, int yA,
@@ -68,3 +84,537 @@ float calculateMSE(
 
     return (A + B + C) / pixelCount;
 }
+
+float calculateErrorSum(
+    const SourceStatistics &A, int xA, int yA,
+    const TargetStatistics &B, int xB, int yB,
+    int width, int height)
+{
+    if(width <= 0 || height <= 0)
+        return 0;
+
+    return calculateErrorSum(
+        A, xA, yA, B, xB, yB, width, height, B.squaredSum(xB, yB, width, height));
+}
+
+float calculateErrorSum(
+    const SourceStatistics &A, int xA, int yA,
+    const TargetStatistics &B, int xB, int yB,
+    int width, int height,
+    double squaredSumB)
+{
+    if(width <= 0 || height <= 0)
+        return 0;
+
+    double crossSum = 0;
+    for(int iy = 0; iy < height; ++iy)
+    {
+        const float *rowA = A.luminance().row(yA + iy) + xA;
+        const float *rowB = B.luminance().row(yB + iy) + xB;
+
+        float rowSum = 0;
+        for(int ix = 0; ix < width; ++ix)
+            rowSum += rowA[ix] * rowB[ix];
+        crossSum += rowSum;
+    }
+
+    const double squaredErrorSum = A.squaredSum(xA, yA, width, height)
+                                 + squaredSumB
+                                 - 2 * crossSum;
+
+    return static_cast<float>((std::max)(squaredErrorSum, 0.0));
+}
+
+TargetOverlapSums calculateTargetOverlapSums(
+    const TargetStatistics &target,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH)
+{
+    const int leftW = tgtX > 0 ? seamW : 0;
+    const int topH  = tgtY > 0 ? seamH : 0;
+
+    TargetOverlapSums result;
+    if(leftW > 0)
+        result.left = target.squaredSum(tgtX, tgtY, leftW, tileH);
+    if(topH > 0)
+        result.top = target.squaredSum(tgtX + leftW, tgtY, tileW - leftW, topH);
+    return result;
+}
+
+float calculateMSE(
+    const SourceStatistics &source,
+    const TargetStatistics &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH)
+{
+    return calculateMSE(
+        source, target, srcX, srcY, tgtX, tgtY, tileW, tileH, seamW, seamH,
+        calculateTargetOverlapSums(target, tgtX, tgtY, tileW, tileH, seamW, seamH));
+}
+
+float calculateMSE(
+    const SourceStatistics  &source,
+    const TargetStatistics  &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH,
+    const TargetOverlapSums &targetSums)
+{
+    if(tgtX <= 0  && tgtY <= 0)
+        return 0;
+
+    // left strip including the corner, then the rest of the top strip
+    const int leftW = tgtX > 0 ? seamW : 0;
+    const int topH  = tgtY > 0 ? seamH : 0;
+
+    const float left = calculateErrorSum(
+        source, srcX, srcY, target, tgtX, tgtY, leftW, tileH, targetSums.left);
+
+    const float top = calculateErrorSum(
+        source, srcX + leftW, srcY, target, tgtX + leftW, tgtY,
+        tileW - leftW, topH, targetSums.top);
+
+    const int pixelCount = leftW * tileH + (tileW - leftW) * topH;
+
+    return (left + top) / pixelCount;
+}
+
+namespace
+{
+    // crossSums[k] += sum_i rowA[i + k] * rowB[i], i < width
+    void accumulateCrossSums(
+        const float *rowA, const float *rowB, int width,
+        double (&crossSums)[MSE_BATCH_SIZE])
+    {
+        static_assert(MSE_BATCH_SIZE == 8);
+
+#ifdef IMAGE_QUILTING_BATCH_SSE
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+
+        for(int ix = 0; ix < width; ++ix)
+        {
+            const __m128 b = _mm_set1_ps(rowB[ix]);
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(rowA + ix),     b));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(rowA + ix + 4), b));
+        }
+
+        alignas(16) float rowSums[MSE_BATCH_SIZE];
+        _mm_store_ps(rowSums,     sum0);
+        _mm_store_ps(rowSums + 4, sum1);
+#else
+        float rowSums[MSE_BATCH_SIZE] = {};
+
+        for(int ix = 0; ix < width; ++ix)
+        {
+            const float b = rowB[ix];
+            for(int k = 0; k < MSE_BATCH_SIZE; ++k)
+                rowSums[k] += rowA[ix + k] * b;
+        }
+#endif
+
+        for(int k = 0; k < MSE_BATCH_SIZE; ++k)
+            crossSums[k] += rowSums[k];
+    }
+
+    void accumulateErrorSumBatch(
+        const SourceStatistics &A, int xA, int yA,
+        const TargetStatistics &B, int xB, int yB,
+        int width, int height,
+        double squaredSumB,
+        double (&errorSums)[MSE_BATCH_SIZE])
+    {
+        if(width <= 0 || height <= 0)
+            return;
+
+        double crossSums[MSE_BATCH_SIZE] = {};
+        for(int iy = 0; iy < height; ++iy)
+        {
+            accumulateCrossSums(
+                A.luminance().row(yA + iy) + xA,
+                B.luminance().row(yB + iy) + xB,
+                width, crossSums);
+        }
+
+        for(int k = 0; k < MSE_BATCH_SIZE; ++k)
+        {
+            const double squaredErrorSum = A.squaredSum(xA + k, yA, width, height)
+                                         + squaredSumB
+                                         - 2 * crossSums[k];
+            errorSums[k] += (std::max)(squaredErrorSum, 0.0);
+        }
+    }
+}
+
+void calculateMSEBatch(
+    const SourceStatistics &source,
+    const TargetStatistics &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH,
+    const TargetOverlapSums &targetSums,
+    float (&result)[MSE_BATCH_SIZE])
+{
+    if(tgtX <= 0  && tgtY <= 0)
+    {
+        std::fill(std::begin(result), std::end(result), 0.0f);
+        return;
+    }
+
+    const int leftW = tgtX > 0 ? seamW : 0;
+    const int topH  = tgtY > 0 ? seamH : 0;
+
+    double errorSums[MSE_BATCH_SIZE] = {};
+
+    accumulateErrorSumBatch(
+        source, srcX, srcY, target, tgtX, tgtY, leftW, tileH,
+        targetSums.left, errorSums);
+
+    accumulateErrorSumBatch(
+        source, srcX + leftW, srcY, target, tgtX + leftW, tgtY,
+        tileW - leftW, topH, targetSums.top, errorSums);
+
+    const int pixelCount = leftW * tileH + (tileW - leftW) * topH;
+
+    for(int k = 0; k < MSE_BATCH_SIZE; ++k)
+        result[k] = static_cast<float>(errorSums[k] / pixelCount);
+}
+
+namespace
+{
+    int64_t squaredDifferenceRowSum(const int16_t *rowA, const int16_t *rowB, int width)
+    {
+        int ix = 0;
+        int64_t result = 0;
+
+#ifdef IMAGE_QUILTING_FIXED_POINT_AVX2
+        __m256i sum256 = _mm256_setzero_si256();
+        for(; ix + 16 <= width; ix += 16)
+        {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rowA + ix));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rowB + ix));
+            const __m256i d = _mm256_sub_epi16(a, b);
+            sum256 = _mm256_add_epi32(sum256, _mm256_madd_epi16(d, d));
+        }
+
+        alignas(32) int32_t lanes256[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes256), sum256);
+        for(int32_t lane : lanes256)
+            result += lane;
+#endif
+
+#ifdef IMAGE_QUILTING_FIXED_POINT_SSE2
+        __m128i sum128 = _mm_setzero_si128();
+        for(; ix + 8 <= width; ix += 8)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rowA + ix));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rowB + ix));
+            const __m128i d = _mm_sub_epi16(a, b);
+            sum128 = _mm_add_epi32(sum128, _mm_madd_epi16(d, d));
+        }
+
+        alignas(16) int32_t lanes128[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes128), sum128);
+        for(int32_t lane : lanes128)
+            result += lane;
+#endif
+
+        for(; ix < width; ++ix)
+        {
+            const int32_t d = rowA[ix] - rowB[ix];
+            result += d * d;
+        }
+
+        return result;
+    }
+}
+
+int64_t calculateErrorSum(
+    const FixedPointLuminancePlane &A, int xA, int yA,
+    const FixedPointLuminancePlane &B, int xB, int yB,
+    int width, int height)
+{
+    int64_t squaredErrorSum = 0;
+    for(int iy = 0; iy < height; ++iy)
+    {
+        squaredErrorSum += squaredDifferenceRowSum(
+            A.row(yA + iy) + xA, B.row(yB + iy) + xB, width);
+    }
+    return squaredErrorSum;
+}
+
+float calculateMSE(
+    const FixedPointLuminancePlane &source,
+    const FixedPointLuminancePlane &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH)
+{
+    if(tgtX <= 0  && tgtY <= 0)
+        return 0;
+
+    const int leftW = tgtX > 0 ? seamW : 0;
+    const int topH  = tgtY > 0 ? seamH : 0;
+
+    const int64_t left = calculateErrorSum(
+        source, srcX, srcY, target, tgtX, tgtY, leftW, tileH);
+
+    const int64_t top = calculateErrorSum(
+        source, srcX + leftW, srcY, target, tgtX + leftW, tgtY,
+        tileW - leftW, topH);
+
+    const int pixelCount = leftW * tileH + (tileW - leftW) * topH;
+
+    constexpr double scale2 = static_cast<double>(LUMINANCE_FIXED_POINT_SCALE)
+                            * LUMINANCE_FIXED_POINT_SCALE;
+
+    return static_cast<float>(static_cast<double>(left + top) / (scale2 * pixelCount));
+}
+
+float calculateErrorSum(
+    const BlockedTexture<Vec3> &A, int xA, int yA,
+    const BlockedTexture<Vec3> &B, int xB, int yB,
+    int width, int height)
+{
+    float squaredErrorSum = 0;
+    for(int iy = 0; iy < height; ++iy)
+    {
+        for(int ix = 0; ix < width;)
+        {
+            const int count = (std::min)({
+                width - ix,
+                BlockedTexture<Vec3>::spanLength(xA + ix),
+                BlockedTexture<Vec3>::spanLength(xB + ix) });
+
+            const Vec3 *spanA = A.span(yA + iy, xA + ix);
+            const Vec3 *spanB = B.span(yB + iy, xB + ix);
+
+            for(int i = 0; i < count; ++i)
+                squaredErrorSum += agz::math::sqr((spanA[i] - spanB[i]).lum());
+
+            ix += count;
+        }
+    }
+    return squaredErrorSum;
+}
+
+float calculateMSE(
+    const BlockedTexture<Vec3> &source,
+    const BlockedTexture<Vec3> &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH)
+{
+    if(tgtX <= 0  && tgtY <= 0)
+        return 0;
+
+    const int leftW = tgtX > 0 ? seamW : 0;
+    const int topH  = tgtY > 0 ? seamH : 0;
+
+    const float left = calculateErrorSum(
+        source, srcX, srcY, target, tgtX, tgtY, leftW, tileH);
+
+    const float top = calculateErrorSum(
+        source, srcX + leftW, srcY, target, tgtX + leftW, tgtY,
+        tileW - leftW, topH);
+
+    const int pixelCount = leftW * tileH + (tileW - leftW) * topH;
+
+    return (left + top) / pixelCount;
+}
+
+namespace
+{
+    // squared differences between the transformed source rectangle at
+    // (u, v) and the target rectangle at (x, y); targetLum(y, x) reads the
+    // target in the source's units
+    template<typename Sum, typename SourcePlane, typename TargetLum>
+    Sum transformedErrorSum(
+        const SourcePlane       &source,
+        const DihedralTransform &transform,
+        int u, int v,
+        const TargetLum         &targetLum,
+        int x, int y,
+        int width, int height)
+    {
+        if(width <= 0 || height <= 0)
+            return 0;
+
+        const int stepU = transform.stepU(source.width());
+        const int stepV = transform.stepV(source.width());
+
+        const agz::math::vec2i origin = transform.sourcePixel(u, v);
+        const auto *first = source.row(origin.y) + origin.x;
+
+        Sum squaredErrorSum = 0;
+        for(int iy = 0; iy < height; ++iy)
+        {
+            const auto *sourcePixel = first + iy * stepV;
+            for(int ix = 0; ix < width; ++ix, sourcePixel += stepU)
+            {
+                const Sum d = static_cast<Sum>(*sourcePixel) - targetLum(y + iy, x + ix);
+                squaredErrorSum += d * d;
+            }
+        }
+        return squaredErrorSum;
+    }
+
+    // left strip including the corner, then the rest of the top strip
+    template<typename Sum, typename SourcePlane, typename TargetLum>
+    double transformedMSE(
+        const SourcePlane       &source,
+        const DihedralTransform &transform,
+        const TargetLum         &targetLum,
+        int srcX, int srcY,
+        int tgtX, int tgtY,
+        int tileW,
+        int tileH,
+        int seamW,
+        int seamH)
+    {
+        if(tgtX <= 0  && tgtY <= 0)
+            return 0;
+
+        const int leftW = tgtX > 0 ? seamW : 0;
+        const int topH  = tgtY > 0 ? seamH : 0;
+
+        const Sum left = transformedErrorSum<Sum>(
+            source, transform, srcX, srcY, targetLum, tgtX, tgtY, leftW, tileH);
+
+        const Sum top = transformedErrorSum<Sum>(
+            source, transform, srcX + leftW, srcY, targetLum, tgtX + leftW, tgtY,
+            tileW - leftW, topH);
+
+        const int pixelCount = leftW * tileH + (tileW - leftW) * topH;
+
+        return static_cast<double>(left + top) / pixelCount;
+    }
+}
+
+float calculateMSE(
+    const LuminancePlane    &source,
+    const DihedralTransform &transform,
+    const Texture<Vec3>     &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH)
+{
+    return static_cast<float>(transformedMSE<float>(
+        source, transform, [&](int y, int x) { return target(y, x).lum(); },
+        srcX, srcY, tgtX, tgtY, tileW, tileH, seamW, seamH));
+}
+
+float calculateMSE(
+    const LuminancePlane    &source,
+    const DihedralTransform &transform,
+    const TargetStatistics  &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH)
+{
+    const LuminancePlane &targetLum = target.luminance();
+    return static_cast<float>(transformedMSE<float>(
+        source, transform, [&](int y, int x) { return targetLum(y, x); },
+        srcX, srcY, tgtX, tgtY, tileW, tileH, seamW, seamH));
+}
+
+float calculateMSE(
+    const LuminancePlane       &source,
+    const DihedralTransform    &transform,
+    const BlockedTexture<Vec3> &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH)
+{
+    return static_cast<float>(transformedMSE<float>(
+        source, transform, [&](int y, int x) { return target(y, x).lum(); },
+        srcX, srcY, tgtX, tgtY, tileW, tileH, seamW, seamH));
+}
+
+float calculateMSE(
+    const FixedPointLuminancePlane &source,
+    const DihedralTransform        &transform,
+    const FixedPointLuminancePlane &target,
+    int srcX, int srcY,
+    int tgtX, int tgtY,
+    int tileW,
+    int tileH,
+    int seamW,
+    int seamH)
+{
+    constexpr double scale2 = static_cast<double>(LUMINANCE_FIXED_POINT_SCALE)
+                            * LUMINANCE_FIXED_POINT_SCALE;
+
+    return static_cast<float>(transformedMSE<int64_t>(
+        source, transform, [&](int y, int x) { return static_cast<int64_t>(target.row(y)[x]); },
+        srcX, srcY, tgtX, tgtY, tileW, tileH, seamW, seamH) / scale2);
+}
+
+float calculateErrorSum(
+    const LuminancePlane &A, const DihedralTransform &transform, int uA, int vA,
+    const Texture<Vec3> &B, int xB, int yB,
+    int width, int height)
+{
+    return transformedErrorSum<float>(
+        A, transform, uA, vA, [&](int y, int x) { return B(y, x).lum(); },
+        xB, yB, width, height);
+}
+
+float calculateErrorSum(
+    const LuminancePlane &A, const DihedralTransform &transform, int uA, int vA,
+    const TargetStatistics &B, int xB, int yB,
+    int width, int height)
+{
+    const LuminancePlane &lumB = B.luminance();
+    return transformedErrorSum<float>(
+        A, transform, uA, vA, [&](int y, int x) { return lumB(y, x); },
+        xB, yB, width, height);
+}
+
+float calculateErrorSum(
+    const LuminancePlane &A, const DihedralTransform &transform, int uA, int vA,
+    const BlockedTexture<Vec3> &B, int xB, int yB,
+    int width, int height)
+{
+    return transformedErrorSum<float>(
+        A, transform, uA, vA, [&](int y, int x) { return B(y, x).lum(); },
+        xB, yB, width, height);
+}
+
+int64_t calculateErrorSum(
+    const FixedPointLuminancePlane &A, const DihedralTransform &transform, int uA, int vA,
+    const FixedPointLuminancePlane &B, int xB, int yB,
+    int width, int height)
+{
+    return transformedErrorSum<int64_t>(
+        A, transform, uA, vA, [&](int y, int x) { return static_cast<int64_t>(B.row(y)[x]); },
+        xB, yB, width, height);
+}
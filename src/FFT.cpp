@@ -0,0 +1,124 @@
+#include "../include/FFT.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    int nextPowerOfTwo(int value) noexcept
+    {
+        int result = 1;
+        while(result < value)
+            result <<= 1;
+        return result;
+    }
+}
+
+void fft(std::complex<double> *data, int count, int stride, bool inverse)
+{
+    // bit-reversal permutation
+    for(int i = 1, j = 0; i < count; ++i)
+    {
+        int bit = count >> 1;
+        for(; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+
+        if(i < j)
+            std::swap(data[i * stride], data[j * stride]);
+    }
+
+    const double sign = inverse ? 1 : -1;
+    for(int length = 2; length <= count; length <<= 1)
+    {
+        const double angle = sign * 2 * 3.14159265358979323846 / length;
+        const std::complex<double> step(std::cos(angle), std::sin(angle));
+
+        for(int begin = 0; begin < count; begin += length)
+        {
+            std::complex<double> w(1);
+            for(int k = 0; k < length / 2; ++k)
+            {
+                std::complex<double> &a = data[(begin + k) * stride];
+                std::complex<double> &b = data[(begin + k + length / 2) * stride];
+
+                const std::complex<double> t = w * b;
+                b = a - t;
+                a += t;
+                w *= step;
+            }
+        }
+    }
+}
+
+void fft2D(std::complex<double> *data, int width, int height, bool inverse)
+{
+    for(int y = 0; y < height; ++y)
+        fft(data + y * width, width, 1, inverse);
+
+    for(int x = 0; x < width; ++x)
+        fft(data + x, height, width, inverse);
+}
+
+PlaneCorrelator::PlaneCorrelator(
+    const LuminancePlane &plane, int patternWidth, int patternHeight)
+    : patternWidth_(patternWidth), patternHeight_(patternHeight),
+      resultWidth_(plane.width() - patternWidth + 1),
+      resultHeight_(plane.height() - patternHeight + 1)
+{
+    if(resultWidth_ <= 0 || resultHeight_ <= 0)
+        throw std::runtime_error("correlation pattern is larger than the plane");
+
+    // positions x <= width - patternWidth never wrap around, so the padded
+    // size only needs to hold the plane
+    fftWidth_  = nextPowerOfTwo(plane.width());
+    fftHeight_ = nextPowerOfTwo(plane.height());
+
+    spectrum_.assign(size_t(fftWidth_) * fftHeight_, 0);
+    for(int y = 0; y < plane.height(); ++y)
+    {
+        const float *row = plane.row(y);
+        for(int x = 0; x < plane.width(); ++x)
+            spectrum_[y * fftWidth_ + x] = row[x];
+    }
+
+    fft2D(spectrum_.data(), fftWidth_, fftHeight_, false);
+}
+
+void PlaneCorrelator::correlate(
+    const float        *pattern,
+    int                 patternStride,
+    std::vector<float> &result) const
+{
+    std::vector<std::complex<double>> buffer(size_t(fftWidth_) * fftHeight_, 0);
+    for(int y = 0; y < patternHeight_; ++y)
+    {
+        for(int x = 0; x < patternWidth_; ++x)
+            buffer[y * fftWidth_ + x] = pattern[y * patternStride + x];
+    }
+
+    // rows past the pattern are zero and stay zero after the row transforms;
+    // of the inverse only the rows holding results are needed
+    for(int y = 0; y < patternHeight_; ++y)
+        fft(buffer.data() + y * fftWidth_, fftWidth_, 1, false);
+    for(int x = 0; x < fftWidth_; ++x)
+        fft(buffer.data() + x, fftHeight_, fftWidth_, false);
+
+    // correlation is the product with the conjugate pattern spectrum
+    for(size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = spectrum_[i] * std::conj(buffer[i]);
+
+    for(int x = 0; x < fftWidth_; ++x)
+        fft(buffer.data() + x, fftHeight_, fftWidth_, true);
+    for(int y = 0; y < resultHeight_; ++y)
+        fft(buffer.data() + y * fftWidth_, fftWidth_, 1, true);
+
+    const double scale = 1.0 / (double(fftWidth_) * fftHeight_);
+    result.resize(size_t(resultWidth_) * resultHeight_);
+    for(int y = 0; y < resultHeight_; ++y)
+    {
+        for(int x = 0; x < resultWidth_; ++x)
+            result[y * resultWidth_ + x] = static_cast<float>(buffer[y * fftWidth_ + x].real() * scale);
+    }
+}
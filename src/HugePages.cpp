@@ -0,0 +1,107 @@
+#include "../include/HugePages.h"
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+    std::atomic<HugePageMode> globalMode      = HugePageMode::Off;
+    std::atomic<size_t>       globalThreshold = HUGE_PAGE_SIZE;
+
+    size_t roundUpToHugePages(size_t bytes) noexcept
+    {
+        return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+}
+
+void setHugePagePolicy(HugePageMode mode, size_t thresholdBytes)
+{
+#ifndef __linux__
+    mode = HugePageMode::Off;
+#endif
+    globalMode      = mode;
+    globalThreshold = thresholdBytes;
+}
+
+HugePageMode hugePageMode() noexcept
+{
+    return globalMode;
+}
+
+size_t hugePageThreshold() noexcept
+{
+    return globalThreshold;
+}
+
+bool adviseHugePages(void *data, size_t bytes) noexcept
+{
+#ifdef __linux__
+    if(globalMode == HugePageMode::Off || bytes < globalThreshold)
+        return false;
+
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(data);
+    const uintptr_t alignedBegin = (begin + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    const uintptr_t alignedEnd = (begin + bytes) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if(alignedEnd <= alignedBegin)
+        return false;
+
+    return madvise(reinterpret_cast<void*>(alignedBegin),
+                   alignedEnd - alignedBegin, MADV_HUGEPAGE) == 0;
+#else
+    (void)data;
+    (void)bytes;
+    return false;
+#endif
+}
+
+void *allocateHugePages(size_t bytes, HugePageMode mode)
+{
+#ifdef __linux__
+    const size_t mappedBytes = roundUpToHugePages(bytes);
+
+    if(mode == HugePageMode::Explicit)
+    {
+        void *data = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(data != MAP_FAILED)
+            return data;
+    }
+
+    // over-map by one huge page to align the start, then trim both ends
+    const size_t paddedBytes = mappedBytes + HUGE_PAGE_SIZE;
+    void *padded = mmap(nullptr, paddedBytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(padded == MAP_FAILED)
+        throw std::bad_alloc();
+
+    const uintptr_t paddedBegin = reinterpret_cast<uintptr_t>(padded);
+    const uintptr_t begin = (paddedBegin + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    const uintptr_t end = begin + mappedBytes;
+
+    if(begin > paddedBegin)
+        munmap(padded, begin - paddedBegin);
+    if(paddedBegin + paddedBytes > end)
+        munmap(reinterpret_cast<void*>(end), paddedBegin + paddedBytes - end);
+
+    void *data = reinterpret_cast<void*>(begin);
+    madvise(data, mappedBytes, MADV_HUGEPAGE);
+    return data;
+#else
+    (void)mode;
+    return ::operator new(bytes);
+#endif
+}
+
+void deallocateHugePages(void *data, size_t bytes) noexcept
+{
+#ifdef __linux__
+    munmap(data, roundUpToHugePages(bytes));
+#else
+    (void)bytes;
+    ::operator delete(data);
+#endif
+}
@@ -0,0 +1,1583 @@
+#include "../include/ImageIO.h"
+#include "../include/Deflate.h"
+
+#include <agz-utils/file.h>
+#include <agz-utils/image.h>
+#include <agz-utils/string.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace
+{
+    // stdin/stdout carry binary image data
+    void setBinaryMode(FILE *file)
+    {
+#ifdef _WIN32
+        _setmode(_fileno(file), _O_BINARY);
+#else
+        (void)file;
+#endif
+    }
+
+    void putBigEndian32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        for(int shift = 24; shift >= 0; shift -= 8)
+            out.push_back(static_cast<uint8_t>(value >> shift));
+    }
+
+    void putLittleEndian(std::vector<uint8_t> &out, uint32_t value, int bytes)
+    {
+        for(int i = 0; i < bytes; ++i)
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void toRGB8(const Vec3 *row, int width, uint8_t *rgb)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            const agz::math::color3b c = agz::math::to_color3b<float>(row[x]);
+            rgb[3 * x + 0] = c.r;
+            rgb[3 * x + 1] = c.g;
+            rgb[3 * x + 2] = c.b;
+        }
+    }
+
+    // big-endian samples, as in PNG
+    void toRGB16(const Vec3 *row, int width, uint8_t *rgb)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            const float channels[3] = { row[x].x, row[x].y, row[x].z };
+            for(int i = 0; i < 3; ++i)
+            {
+                const float value = std::clamp(channels[i], 0.0f, 1.0f);
+                const auto sample = static_cast<uint16_t>(std::lround(value * 65535));
+                rgb[6 * x + 2 * i]     = static_cast<uint8_t>(sample >> 8);
+                rgb[6 * x + 2 * i + 1] = static_cast<uint8_t>(sample);
+            }
+        }
+    }
+
+    void putFloat32(std::vector<uint8_t> &out, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        putLittleEndian(out, bits, 4);
+    }
+
+    // round to nearest even; overflows to infinity, NaN stays NaN
+    uint16_t floatToHalf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        const uint32_t sign = (bits >> 16) & 0x8000;
+        const uint32_t magnitude = bits & 0x7fffffff;
+
+        if(magnitude >= 0x7f800000)
+            return static_cast<uint16_t>(sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0));
+
+        // 65520 and above round to infinity
+        if(magnitude >= 0x477ff000)
+            return static_cast<uint16_t>(sign | 0x7c00);
+
+        if(magnitude < 0x38800000)
+        {
+            // subnormal: shift the mantissa with its implicit bit into place
+            if(magnitude < 0x33000000)
+                return static_cast<uint16_t>(sign);
+            const int shift = 126 - static_cast<int>(magnitude >> 23);
+            const uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+            const uint32_t half = mantissa >> shift;
+            const uint32_t rest = mantissa & ((1u << shift) - 1);
+            const uint32_t halfway = 1u << (shift - 1);
+            return static_cast<uint16_t>(
+                sign | (half + (rest > halfway || (rest == halfway && (half & 1)))));
+        }
+
+        // rebias the exponent from 127 to 15; the carry of rounding may
+        // increment it, up to infinity
+        const uint32_t rebased = magnitude - 0x38000000;
+        const uint32_t half = rebased >> 13;
+        const uint32_t rest = rebased & 0x1fff;
+        return static_cast<uint16_t>(
+            sign | (half + (rest > 0x1000 || (rest == 0x1000 && (half & 1)))));
+    }
+
+    float halfToFloat(uint16_t value)
+    {
+        const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+        const uint32_t exponent = (value >> 10) & 0x1f;
+        uint32_t mantissa = value & 0x3ff;
+
+        uint32_t bits;
+        if(exponent == 0x1f)
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        else if(exponent != 0)
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        else if(mantissa == 0)
+            bits = sign;
+        else
+        {
+            // subnormal: normalize the mantissa
+            int shift = 0;
+            while(!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                ++shift;
+            }
+            bits = sign | (static_cast<uint32_t>(113 - shift) << 23) | ((mantissa & 0x3ff) << 13);
+        }
+
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    // Rows of scanline formats, from writeRow or assembled from the tiles
+    // covering them
+    class ScanlineWriter : public ImageWriter
+    {
+    public:
+
+        ScanlineWriter(std::ostream &out, int width, int height)
+            : out_(out), width_(width), height_(height)
+        {
+            if(width <= 0 || height <= 0)
+                throw std::runtime_error("cannot encode an empty image");
+        }
+
+        void writeRow(const Vec3 *row) final
+        {
+            if(writtenRows_ == height_)
+                throw std::runtime_error("image writer received more rows than the image height");
+            encodeRow(row);
+            ++writtenRows_;
+        }
+
+        void writeTile(int x, int y, int width, int height, const Vec3 *pixels, size_t stride) final
+        {
+            if(x < 0 || y < writtenRows_ || width <= 0 || height <= 0 ||
+               x + width > width_ || y + height > height_)
+                throw std::runtime_error("image tile outside the rows still to be written");
+
+            // pending rows start at writtenRows_
+            const size_t end = static_cast<size_t>(y + height - writtenRows_);
+            while(pendingRows_.size() < end)
+            {
+                pendingRows_.emplace_back(width_);
+                pendingPixels_.push_back(0);
+            }
+
+            for(int yi = 0; yi < height; ++yi)
+            {
+                const size_t row = static_cast<size_t>(y + yi - writtenRows_);
+                std::copy(pixels + yi * stride, pixels + yi * stride + width,
+                          pendingRows_[row].begin() + x);
+                pendingPixels_[row] += width;
+            }
+
+            while(!pendingRows_.empty() && pendingPixels_.front() == width_)
+            {
+                writeRow(pendingRows_.front().data());
+                pendingRows_.pop_front();
+                pendingPixels_.pop_front();
+            }
+        }
+
+        void finish() final
+        {
+            if(writtenRows_ != height_)
+                throw std::runtime_error("image writer finished before the last row");
+            encodeEnd();
+            out_.flush();
+            if(!out_)
+                throw std::runtime_error("failed to write image");
+        }
+
+    protected:
+
+        virtual void encodeRow(const Vec3 *row) = 0;
+
+        virtual void encodeEnd() = 0;
+
+        void write(const std::vector<uint8_t> &data)
+        {
+            out_.write(reinterpret_cast<const char *>(data.data()),
+                       static_cast<std::streamsize>(data.size()));
+        }
+
+        std::ostream &out_;
+        int width_;
+        int height_;
+
+    private:
+
+        int writtenRows_ = 0;
+
+        std::deque<std::vector<Vec3>> pendingRows_;
+        std::deque<int>               pendingPixels_;
+    };
+
+    class PPMWriter : public ScanlineWriter
+    {
+    public:
+
+        PPMWriter(std::ostream &out, int width, int height)
+            : ScanlineWriter(out, width, height), row_(3 * size_t(width))
+        {
+            out_ << "P6\n" << width << " " << height << "\n255\n";
+        }
+
+    protected:
+
+        void encodeRow(const Vec3 *row) override
+        {
+            toRGB8(row, width_, row_.data());
+            write(row_);
+        }
+
+        void encodeEnd() override { }
+
+    private:
+
+        std::vector<uint8_t> row_;
+    };
+
+    // 24-bit top-down bitmap (negative height), so that rows are written in
+    // the order they arrive
+    class BMPWriter : public ScanlineWriter
+    {
+    public:
+
+        BMPWriter(std::ostream &out, int width, int height)
+            : ScanlineWriter(out, width, height),
+              row_((3 * size_t(width) + 3) / 4 * 4, 0)
+        {
+            const uint32_t headerSize = 14 + 40;
+            const uint32_t imageSize  = static_cast<uint32_t>(row_.size() * height);
+
+            std::vector<uint8_t> header;
+            header.push_back('B');
+            header.push_back('M');
+            putLittleEndian(header, headerSize + imageSize, 4);
+            putLittleEndian(header, 0, 4);
+            putLittleEndian(header, headerSize, 4);
+
+            putLittleEndian(header, 40, 4);
+            putLittleEndian(header, static_cast<uint32_t>(width), 4);
+            putLittleEndian(header, static_cast<uint32_t>(-height), 4);
+            putLittleEndian(header, 1, 2);
+            putLittleEndian(header, 24, 2);
+            putLittleEndian(header, 0, 4);
+            putLittleEndian(header, imageSize, 4);
+            // 72 dpi
+            putLittleEndian(header, 2835, 4);
+            putLittleEndian(header, 2835, 4);
+            putLittleEndian(header, 0, 4);
+            putLittleEndian(header, 0, 4);
+            write(header);
+        }
+
+    protected:
+
+        void encodeRow(const Vec3 *row) override
+        {
+            toRGB8(row, width_, row_.data());
+            for(int x = 0; x < width_; ++x)
+                std::swap(row_[3 * x], row_[3 * x + 2]);
+            write(row_);
+        }
+
+        void encodeEnd() override { }
+
+    private:
+
+        std::vector<uint8_t> row_;
+    };
+
+    // 8- or 16-bit RGB PNG. Every row gets the filter with the smallest sum of
+    // absolute filtered values. The filtered rows are collected into strips
+    // of at least STRIP_SIZE bytes, which are deflated independently (see
+    // deflateStrip) on up to options.threads threads while the next strips
+    // fill; the deflate data is written in order, in an IDAT chunk whenever
+    // IDAT_SIZE bytes have accumulated.
+    class PNGWriter : public ScanlineWriter
+    {
+    public:
+
+        static constexpr size_t IDAT_SIZE  = size_t(1) << 16;
+        static constexpr size_t STRIP_SIZE = size_t(1) << 18;
+
+        // deflate keeps a 32KB window
+        static constexpr size_t DICTIONARY_SIZE = size_t(1) << 15;
+
+        PNGWriter(
+            std::ostream             &out,
+            int                       width,
+            int                       height,
+            int                       bitDepth,
+            const ImageWriterOptions &options)
+            : ScanlineWriter(out, width, height),
+              bitDepth_(bitDepth), bytesPerPixel_(3 * bitDepth / 8),
+              level_(options.compressionLevel), threads_(std::max(options.threads, 1)),
+              previous_(bytesPerPixel_ * size_t(width), 0), current_(bytesPerPixel_ * size_t(width)),
+              filtered_(bytesPerPixel_ * size_t(width) + 1)
+        {
+            static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+            write(std::vector<uint8_t>(SIGNATURE, SIGNATURE + 8));
+
+            std::vector<uint8_t> header;
+            putBigEndian32(header, static_cast<uint32_t>(width));
+            putBigEndian32(header, static_cast<uint32_t>(height));
+            // RGB, deflate, adaptive filtering, no interlace
+            header.insert(header.end(), { static_cast<uint8_t>(bitDepth), 2, 0, 0, 0 });
+            writeChunk("IHDR", header);
+        }
+
+    protected:
+
+        void encodeRow(const Vec3 *row) override
+        {
+            if(bitDepth_ == 16)
+                toRGB16(row, width_, current_.data());
+            else
+                toRGB8(row, width_, current_.data());
+            filterRow();
+            strip_.insert(strip_.end(), filtered_.begin(), filtered_.end());
+            std::swap(previous_, current_);
+
+            if(strip_.size() >= STRIP_SIZE)
+                submitStrip(false);
+        }
+
+        void encodeEnd() override
+        {
+            submitStrip(true);
+            while(!pending_.empty())
+                writePendingStrip();
+
+            putBigEndian32(compressed_, adler_);
+            writeChunk("IDAT", compressed_);
+            writeChunk("IEND", {});
+        }
+
+    private:
+
+        struct CompressedStrip
+        {
+            std::vector<uint8_t> data;
+            uint32_t adler = 1;
+            size_t   size  = 0;
+        };
+
+        // compresses strip_ inline with one thread, asynchronously otherwise
+        void submitStrip(bool final)
+        {
+            auto compress = [level = level_, final](
+                std::vector<uint8_t> input, std::vector<uint8_t> dictionary)
+            {
+                CompressedStrip result;
+                deflateStrip(input.data(), input.size(), dictionary.data(), dictionary.size(),
+                             level, final, result.data);
+                result.adler = adler32(1, input.data(), input.size());
+                result.size  = input.size();
+                return result;
+            };
+
+            std::vector<uint8_t> dictionary = std::move(dictionary_);
+            const size_t keep = std::min(strip_.size(), DICTIONARY_SIZE);
+            dictionary_.assign(strip_.end() - keep, strip_.end());
+
+            if(threads_ == 1)
+                writeStrip(compress(std::move(strip_), std::move(dictionary)));
+            else
+            {
+                while(pending_.size() >= static_cast<size_t>(threads_))
+                    writePendingStrip();
+                pending_.push_back(std::async(
+                    std::launch::async, compress, std::move(strip_), std::move(dictionary)));
+            }
+            strip_.clear();
+        }
+
+        void writePendingStrip()
+        {
+            CompressedStrip strip = pending_.front().get();
+            pending_.pop_front();
+            writeStrip(strip);
+        }
+
+        void writeStrip(const CompressedStrip &strip)
+        {
+            if(!headerWritten_)
+            {
+                writeZlibHeader(level_, compressed_);
+                headerWritten_ = true;
+            }
+
+            compressed_.insert(compressed_.end(), strip.data.begin(), strip.data.end());
+            adler_ = adler32Combine(adler_, strip.adler, strip.size);
+
+            if(compressed_.size() >= IDAT_SIZE)
+            {
+                writeChunk("IDAT", compressed_);
+                compressed_.clear();
+            }
+        }
+
+        void filterRow()
+        {
+            const size_t size = current_.size();
+            std::vector<uint8_t> candidate(size);
+
+            uint64_t bestCost = UINT64_MAX;
+            for(uint8_t filter = 0; filter < 5; ++filter)
+            {
+                uint64_t cost = 0;
+                for(size_t i = 0; i < size; ++i)
+                {
+                    const size_t bpp = bytesPerPixel_;
+                    const int a = i >= bpp ? current_[i - bpp] : 0;
+                    const int b = previous_[i];
+                    const int c = i >= bpp ? previous_[i - bpp] : 0;
+
+                    int predictor = 0;
+                    switch(filter)
+                    {
+                    case 1: predictor = a;           break;
+                    case 2: predictor = b;           break;
+                    case 3: predictor = (a + b) / 2; break;
+                    case 4:
+                        {
+                            const int p = a + b - c;
+                            const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                            predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+                        }
+                        break;
+                    default: break;
+                    }
+
+                    candidate[i] = static_cast<uint8_t>(current_[i] - predictor);
+                    cost += std::abs(static_cast<int8_t>(candidate[i]));
+                }
+
+                if(cost < bestCost)
+                {
+                    bestCost = cost;
+                    filtered_[0] = filter;
+                    std::copy(candidate.begin(), candidate.end(), filtered_.begin() + 1);
+                }
+            }
+        }
+
+        void writeChunk(const char *type, const std::vector<uint8_t> &data)
+        {
+            std::vector<uint8_t> chunk;
+            chunk.reserve(data.size() + 12);
+            putBigEndian32(chunk, static_cast<uint32_t>(data.size()));
+            chunk.insert(chunk.end(), type, type + 4);
+            chunk.insert(chunk.end(), data.begin(), data.end());
+            putBigEndian32(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+            write(chunk);
+        }
+
+        int    bitDepth_;
+        size_t bytesPerPixel_;
+
+        int level_;
+        int threads_;
+
+        std::vector<uint8_t> previous_;
+        std::vector<uint8_t> current_;
+        std::vector<uint8_t> filtered_;
+
+        // filtered rows of the next strip and the end of the previous one
+        std::vector<uint8_t> strip_;
+        std::vector<uint8_t> dictionary_;
+
+        std::deque<std::future<CompressedStrip>> pending_;
+
+        bool     headerWritten_ = false;
+        uint32_t adler_         = 1;
+
+        std::vector<uint8_t> compressed_;
+    };
+
+    // RGB float32 portable float map with little-endian samples. Its rows
+    // are stored from bottom to top: they are written into their place when
+    // out can seek, and collected until the end otherwise.
+    class PFMWriter : public ScanlineWriter
+    {
+    public:
+
+        PFMWriter(std::ostream &out, int width, int height)
+            : ScanlineWriter(out, width, height), rowBytes_(12 * size_t(width))
+        {
+            // the negative scale marks little-endian samples
+            out_ << "PF\n" << width << " " << height << "\n-1.0\n";
+
+            dataBegin_ = out_.tellp();
+            if(dataBegin_ == std::streampos(-1))
+                buffered_.resize(rowBytes_ * height);
+        }
+
+    protected:
+
+        void encodeRow(const Vec3 *row) override
+        {
+            row_.clear();
+            for(int x = 0; x < width_; ++x)
+            {
+                putFloat32(row_, row[x].x);
+                putFloat32(row_, row[x].y);
+                putFloat32(row_, row[x].z);
+            }
+
+            const size_t offset = rowBytes_ * (height_ - 1 - nextRow_++);
+            if(buffered_.empty())
+            {
+                out_.seekp(dataBegin_ + static_cast<std::streamoff>(offset));
+                write(row_);
+            }
+            else
+                std::copy(row_.begin(), row_.end(), buffered_.begin() + offset);
+        }
+
+        void encodeEnd() override
+        {
+            if(buffered_.empty())
+                out_.seekp(dataBegin_ + static_cast<std::streamoff>(rowBytes_ * height_));
+            else
+                write(buffered_);
+        }
+
+    private:
+
+        size_t rowBytes_;
+        int    nextRow_ = 0;
+
+        std::streampos       dataBegin_;
+        std::vector<uint8_t> row_;
+        std::vector<uint8_t> buffered_;
+    };
+
+    constexpr char TILED_HALF_MAGIC[4] = { 'H', 'F', 'T', '1' };
+
+    // Half-float tiles: a header of TILED_HALF_MAGIC and the little-endian
+    // uint32 width, height, tile width, tile height and channel count (3),
+    // then every tile as its little-endian uint32 tile column and row and its
+    // RGB float16 pixels row by row, cropped at the image edges. Like the
+    // tiles of OpenEXR files, the tiles may come in any order.
+    class TiledHalfWriter : public ImageWriter
+    {
+    public:
+
+        TiledHalfWriter(std::ostream &out, int width, int height, int tileSize)
+            : out_(out), width_(width), height_(height), tileSize_(tileSize)
+        {
+            if(width <= 0 || height <= 0)
+                throw std::runtime_error("cannot encode an empty image");
+            if(tileSize <= 0)
+                throw std::runtime_error("tile size must be positive");
+
+            tilesX_ = (width + tileSize - 1) / tileSize;
+            tilesY_ = (height + tileSize - 1) / tileSize;
+            writtenTiles_.assign(size_t(tilesX_) * tilesY_, 0);
+
+            std::vector<uint8_t> header(TILED_HALF_MAGIC, TILED_HALF_MAGIC + 4);
+            for(int field : { width, height, tileSize, tileSize, 3 })
+                putLittleEndian(header, static_cast<uint32_t>(field), 4);
+            write(header);
+        }
+
+        // collects a band of tile rows
+        void writeRow(const Vec3 *row) override
+        {
+            if(rows_ == height_)
+                throw std::runtime_error("image writer received more rows than the image height");
+
+            band_.insert(band_.end(), row, row + width_);
+            if(++rows_ % tileSize_ != 0 && rows_ != height_)
+                return;
+
+            const int top = (rows_ - 1) / tileSize_ * tileSize_;
+            for(int x = 0; x < width_; x += tileSize_)
+            {
+                writeTile(x, top, std::min(tileSize_, width_ - x), rows_ - top,
+                          band_.data() + x, static_cast<size_t>(width_));
+            }
+            band_.clear();
+        }
+
+        void writeTile(int x, int y, int width, int height, const Vec3 *pixels, size_t stride) override
+        {
+            if(x < 0 || y < 0 || x >= width_ || y >= height_ || x % tileSize_ || y % tileSize_ ||
+               width != std::min(tileSize_, width_ - x) || height != std::min(tileSize_, height_ - y))
+            {
+                throw std::runtime_error(
+                    "tiles of half-float tiled images must match their " +
+                    std::to_string(tileSize_) + " pixel grid");
+            }
+
+            const int tileX = x / tileSize_, tileY = y / tileSize_;
+            char &written = writtenTiles_[size_t(tileY) * tilesX_ + tileX];
+            if(written)
+                throw std::runtime_error("image tile written twice");
+            written = 1;
+
+            tile_.clear();
+            putLittleEndian(tile_, static_cast<uint32_t>(tileX), 4);
+            putLittleEndian(tile_, static_cast<uint32_t>(tileY), 4);
+            for(int yi = 0; yi < height; ++yi)
+            {
+                for(int xi = 0; xi < width; ++xi)
+                {
+                    const Vec3 &pixel = pixels[yi * stride + xi];
+                    putLittleEndian(tile_, floatToHalf(pixel.x), 2);
+                    putLittleEndian(tile_, floatToHalf(pixel.y), 2);
+                    putLittleEndian(tile_, floatToHalf(pixel.z), 2);
+                }
+            }
+            write(tile_);
+        }
+
+        void finish() override
+        {
+            if(std::find(writtenTiles_.begin(), writtenTiles_.end(), 0) != writtenTiles_.end())
+                throw std::runtime_error("image writer finished before the last tile");
+            out_.flush();
+            if(!out_)
+                throw std::runtime_error("failed to write image");
+        }
+
+    private:
+
+        void write(const std::vector<uint8_t> &data)
+        {
+            out_.write(reinterpret_cast<const char *>(data.data()),
+                       static_cast<std::streamsize>(data.size()));
+        }
+
+        std::ostream &out_;
+        int width_;
+        int height_;
+        int tileSize_;
+        int tilesX_ = 0;
+        int tilesY_ = 0;
+        int rows_   = 0;
+
+        std::vector<char>    writtenTiles_;
+        std::vector<Vec3>    band_;
+        std::vector<uint8_t> tile_;
+    };
+
+    // next whitespace-separated header field, skipping comments; consumes
+    // the single whitespace character after it
+    std::string readPPMField(std::istream &in)
+    {
+        int c = in.get();
+        while(c == '#' || std::isspace(c))
+        {
+            if(c == '#')
+            {
+                while(c != '\n' && c != EOF)
+                    c = in.get();
+            }
+            c = in.get();
+        }
+
+        std::string field;
+        while(c != EOF && !std::isspace(c))
+        {
+            field.push_back(static_cast<char>(c));
+            c = in.get();
+        }
+        return field;
+    }
+
+    int parsePPMNumber(const std::string &field)
+    {
+        char *end = nullptr;
+        const long value = std::strtol(field.c_str(), &end, 10);
+        if(field.empty() || *end || value <= 0 || value > (1 << 24))
+            throw std::runtime_error("invalid image header field: " + field);
+        return static_cast<int>(value);
+    }
+
+    uint32_t getLittleEndian32(const uint8_t *data)
+    {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    uint32_t getBigEndian32(const uint8_t *data)
+    {
+        return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+    }
+
+    Texture<Vec3> readPPM(std::istream &in)
+    {
+        if(readPPMField(in) != "P6")
+            throw std::runtime_error("not a binary PPM (P6) image");
+
+        const int width    = parsePPMNumber(readPPMField(in));
+        const int height   = parsePPMNumber(readPPMField(in));
+        const int maxValue = parsePPMNumber(readPPMField(in));
+        if(maxValue > 65535)
+            throw std::runtime_error("invalid PPM maximum value");
+
+        const int bytesPerSample = maxValue < 256 ? 1 : 2;
+        const float scale = 1.0f / maxValue;
+
+        Texture<Vec3> result(height, width);
+        std::vector<uint8_t> row(3 * size_t(width) * bytesPerSample);
+        for(int y = 0; y < height; ++y)
+        {
+            in.read(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(row.size()));
+            if(in.gcount() != static_cast<std::streamsize>(row.size()))
+                throw std::runtime_error("truncated PPM image");
+
+            Vec3 *out = result.raw_data() + size_t(y) * width;
+            for(int x = 0; x < width; ++x)
+            {
+                float rgb[3];
+                for(int i = 0; i < 3; ++i)
+                {
+                    const size_t s = 3 * size_t(x) + i;
+                    const int value = bytesPerSample == 1 ? row[s] :
+                        (row[2 * s] << 8) | row[2 * s + 1];
+                    rgb[i] = value * scale;
+                }
+                out[x] = Vec3(rgb[0], rgb[1], rgb[2]);
+            }
+        }
+        return result;
+    }
+
+    // PF (RGB) or Pf (grey) float map of either byte order; the magnitude of
+    // the scale field is ignored
+    Texture<Vec3> readPFM(std::istream &in)
+    {
+        const std::string type = readPPMField(in);
+        if(type != "PF" && type != "Pf")
+            throw std::runtime_error("not a portable float map (PF/Pf)");
+        const int channels = type == "PF" ? 3 : 1;
+
+        const int width  = parsePPMNumber(readPPMField(in));
+        const int height = parsePPMNumber(readPPMField(in));
+
+        const std::string scaleField = readPPMField(in);
+        char *end = nullptr;
+        const float scale = std::strtof(scaleField.c_str(), &end);
+        if(scaleField.empty() || *end || scale == 0)
+            throw std::runtime_error("invalid image header field: " + scaleField);
+        const bool littleEndian = scale < 0;
+
+        Texture<Vec3> result(height, width);
+        std::vector<uint8_t> row(4 * channels * size_t(width));
+        for(int y = 0; y < height; ++y)
+        {
+            in.read(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(row.size()));
+            if(in.gcount() != static_cast<std::streamsize>(row.size()))
+                throw std::runtime_error("truncated PFM image");
+
+            // bottom to top
+            Vec3 *out = result.raw_data() + size_t(height - 1 - y) * width;
+            for(int x = 0; x < width; ++x)
+            {
+                float values[3];
+                for(int i = 0; i < channels; ++i)
+                {
+                    uint8_t bytes[4];
+                    std::copy_n(row.data() + 4 * (size_t(x) * channels + i), 4, bytes);
+                    if(!littleEndian)
+                        std::reverse(bytes, bytes + 4);
+
+                    const uint32_t bits = getLittleEndian32(bytes);
+                    std::memcpy(&values[i], &bits, sizeof(float));
+                }
+                out[x] = channels == 3 ? Vec3(values[0], values[1], values[2]) : Vec3(values[0]);
+            }
+        }
+        return result;
+    }
+
+    // see TiledHalfWriter
+    Texture<Vec3> readTiledHalf(std::istream &in)
+    {
+        uint8_t header[24];
+        in.read(reinterpret_cast<char *>(header), sizeof(header));
+        if(in.gcount() != static_cast<std::streamsize>(sizeof(header)) ||
+           !std::equal(header, header + 4, TILED_HALF_MAGIC))
+            throw std::runtime_error("not a half-float tiled image");
+
+        auto field = [&](int index)
+        {
+            const uint32_t value = getLittleEndian32(header + 4 + 4 * index);
+            if(value == 0 || value > (1u << 24))
+                throw std::runtime_error("invalid half-float tiled image header");
+            return static_cast<int>(value);
+        };
+
+        const int width      = field(0);
+        const int height     = field(1);
+        const int tileWidth  = field(2);
+        const int tileHeight = field(3);
+        if(field(4) != 3)
+            throw std::runtime_error("half-float tiled images must have 3 channels");
+
+        const int tilesX = (width + tileWidth - 1) / tileWidth;
+        const int tilesY = (height + tileHeight - 1) / tileHeight;
+
+        Texture<Vec3> result(height, width);
+        std::vector<char> seen(size_t(tilesX) * tilesY, 0);
+        std::vector<uint8_t> tile;
+
+        for(size_t remaining = seen.size(); remaining > 0; --remaining)
+        {
+            uint8_t position[8];
+            in.read(reinterpret_cast<char *>(position), sizeof(position));
+            if(in.gcount() != static_cast<std::streamsize>(sizeof(position)))
+                throw std::runtime_error("truncated half-float tiled image");
+
+            const uint32_t tileX = getLittleEndian32(position);
+            const uint32_t tileY = getLittleEndian32(position + 4);
+            if(tileX >= static_cast<uint32_t>(tilesX) || tileY >= static_cast<uint32_t>(tilesY) ||
+               seen[tileY * tilesX + tileX])
+                throw std::runtime_error("invalid tile in half-float tiled image");
+            seen[tileY * tilesX + tileX] = 1;
+
+            const int x = tileX * tileWidth, y = tileY * tileHeight;
+            const int w = std::min(tileWidth, width - x), h = std::min(tileHeight, height - y);
+
+            tile.resize(6 * size_t(w) * h);
+            in.read(reinterpret_cast<char *>(tile.data()), static_cast<std::streamsize>(tile.size()));
+            if(in.gcount() != static_cast<std::streamsize>(tile.size()))
+                throw std::runtime_error("truncated half-float tiled image");
+
+            const uint8_t *sample = tile.data();
+            for(int yi = 0; yi < h; ++yi)
+            {
+                for(int xi = 0; xi < w; ++xi, sample += 6)
+                {
+                    result(y + yi, x + xi) = Vec3(
+                        halfToFloat(static_cast<uint16_t>(sample[0] | (sample[1] << 8))),
+                        halfToFloat(static_cast<uint16_t>(sample[2] | (sample[3] << 8))),
+                        halfToFloat(static_cast<uint16_t>(sample[4] | (sample[5] << 8))));
+                }
+            }
+        }
+        return result;
+    }
+
+    // keeps the file open for the writer encoding into it
+    class FileImageWriter : public ImageWriter
+    {
+    public:
+
+        FileImageWriter(
+            std::unique_ptr<std::ofstream> file,
+            std::unique_ptr<ImageWriter>   writer)
+            : file_(std::move(file)), writer_(std::move(writer))
+        {
+
+        }
+
+        void writeRow(const Vec3 *row) override
+        {
+            writer_->writeRow(row);
+        }
+
+        void writeTile(int x, int y, int width, int height, const Vec3 *pixels, size_t stride) override
+        {
+            writer_->writeTile(x, y, width, height, pixels, stride);
+        }
+
+        void finish() override
+        {
+            writer_->finish();
+            file_->close();
+        }
+
+    private:
+
+        std::unique_ptr<std::ofstream> file_;
+        std::unique_ptr<ImageWriter>   writer_;
+    };
+
+    // Image is what the agz-utils loaders return
+    template<typename Image>
+    Texture<Vec3> fromRGB8(const Image &image)
+    {
+        return Texture<Vec3>(image.map([](const agz::math::color3b &c)
+        {
+            return Vec3(agz::math::from_color3b<float>(c));
+        }));
+    }
+
+    // PNG of any colour type and bit depth, interlaced or not, decoded while
+    // it is read: IDAT chunks are read in pieces of at most INPUT_SIZE bytes
+    // and inflated row by row, so the encoded image is never held as a
+    // whole. Alpha and ancillary chunks (gamma, colour profiles, ...) are
+    // ignored, as by agz-utils.
+    class PNGReader
+    {
+    public:
+
+        static constexpr size_t INPUT_SIZE = size_t(1) << 16;
+
+        explicit PNGReader(std::istream &in)
+            : in_(in)
+        {
+
+        }
+
+        Texture<Vec3> read()
+        {
+            static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+            uint8_t signature[8];
+            readBytes(signature, sizeof(signature));
+            if(!std::equal(signature, signature + 8, SIGNATURE))
+                throw std::runtime_error("not a PNG image");
+
+            nextChunk();
+            if(chunkType_ != "IHDR" || chunkRemaining_ != 13)
+                throw std::runtime_error("PNG image does not start with IHDR");
+            uint8_t header[13];
+            readChunkData(header, sizeof(header));
+            endChunk();
+            parseHeader(header);
+
+            // ancillary chunks before the image data are skipped
+            for(nextChunk(); chunkType_ != "IDAT"; nextChunk())
+            {
+                if(chunkType_ == "PLTE")
+                    readPalette();
+                else if(chunkType_ == "IEND" || !std::islower(static_cast<unsigned char>(chunkType_[0])))
+                    throw std::runtime_error("unexpected PNG chunk " + chunkType_);
+                else
+                    skipChunk();
+            }
+            if(colorType_ == 3 && palette_.empty())
+                throw std::runtime_error("palette PNG image without PLTE chunk");
+
+            Texture<Vec3> result(height_, width_);
+            if(interlaced_)
+            {
+                // Adam7 passes, each a reduced image of its own
+                static const int PASSES[7][4] = {
+                    { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 },
+                    { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+                for(const auto &pass : PASSES)
+                    readPass(result, pass[0], pass[1], pass[2], pass[3]);
+            }
+            else
+                readPass(result, 0, 0, 1, 1);
+
+            // the rest of the image data and any trailing chunks, up to IEND
+            skipChunk();
+            for(nextChunk(); chunkType_ != "IEND"; nextChunk())
+                skipChunk();
+            endChunk();
+            return result;
+        }
+
+    private:
+
+        void parseHeader(const uint8_t *header)
+        {
+            const uint32_t width  = getBigEndian32(header);
+            const uint32_t height = getBigEndian32(header + 4);
+            if(width == 0 || height == 0 || width > (1u << 24) || height > (1u << 24))
+                throw std::runtime_error("invalid PNG image size");
+            width_  = static_cast<int>(width);
+            height_ = static_cast<int>(height);
+
+            bitDepth_  = header[8];
+            colorType_ = header[9];
+
+            int channels = 0;
+            bool validDepth = false;
+            switch(colorType_)
+            {
+            case 0: channels = 1; validDepth = bitDepth_ == 1 || bitDepth_ == 2 || bitDepth_ == 4 ||
+                                               bitDepth_ == 8 || bitDepth_ == 16; break;
+            case 3: channels = 1; validDepth = bitDepth_ == 1 || bitDepth_ == 2 || bitDepth_ == 4 ||
+                                               bitDepth_ == 8; break;
+            case 2: channels = 3; validDepth = bitDepth_ == 8 || bitDepth_ == 16; break;
+            case 4: channels = 2; validDepth = bitDepth_ == 8 || bitDepth_ == 16; break;
+            case 6: channels = 4; validDepth = bitDepth_ == 8 || bitDepth_ == 16; break;
+            default: break;
+            }
+            if(!validDepth)
+                throw std::runtime_error("invalid PNG colour type or bit depth");
+            if(header[10] != 0 || header[11] != 0 || header[12] > 1)
+                throw std::runtime_error("unsupported PNG compression, filter or interlace method");
+
+            bitsPerPixel_ = channels * bitDepth_;
+            interlaced_   = header[12] == 1;
+        }
+
+        void readPalette()
+        {
+            if(chunkRemaining_ == 0 || chunkRemaining_ % 3 != 0 || chunkRemaining_ > 3 * 256)
+                throw std::runtime_error("invalid PNG palette");
+            std::vector<uint8_t> entries(chunkRemaining_);
+            readChunkData(entries.data(), entries.size());
+            endChunk();
+
+            palette_.clear();
+            for(size_t i = 0; i < entries.size(); i += 3)
+            {
+                palette_.push_back(
+                    Vec3(entries[i] / 255.0f, entries[i + 1] / 255.0f, entries[i + 2] / 255.0f));
+            }
+        }
+
+        // rows of the pixels (x0 + i * dx, y0 + j * dy)
+        void readPass(Texture<Vec3> &result, int x0, int y0, int dx, int dy)
+        {
+            if(x0 >= width_ || y0 >= height_)
+                return;
+            const int passWidth = (width_ - x0 + dx - 1) / dx;
+
+            const size_t rowBytes = (size_t(passWidth) * bitsPerPixel_ + 7) / 8;
+            const size_t bpp = std::max(bitsPerPixel_ / 8, 1);
+
+            std::vector<uint8_t> previous(rowBytes, 0), current(rowBytes + 1);
+            for(int y = y0; y < height_; y += dy)
+            {
+                inflateExactly(current.data(), current.size());
+                unfilterRow(current[0], current.data() + 1, previous.data(), rowBytes, bpp);
+                std::copy(current.begin() + 1, current.end(), previous.begin());
+
+                Vec3 *out = result.raw_data() + size_t(y) * width_;
+                for(int i = 0, x = x0; i < passWidth; ++i, x += dx)
+                    out[x] = pixel(previous.data(), i);
+            }
+        }
+
+        static void unfilterRow(
+            uint8_t filter, uint8_t *row, const uint8_t *previous, size_t size, size_t bpp)
+        {
+            for(size_t i = 0; i < size; ++i)
+            {
+                const int a = i >= bpp ? row[i - bpp] : 0;
+                const int b = previous[i];
+                const int c = i >= bpp ? previous[i - bpp] : 0;
+
+                int predictor = 0;
+                switch(filter)
+                {
+                case 0: break;
+                case 1: predictor = a;           break;
+                case 2: predictor = b;           break;
+                case 3: predictor = (a + b) / 2; break;
+                case 4:
+                    {
+                        const int p = a + b - c;
+                        const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                        predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+                    }
+                    break;
+                default:
+                    throw std::runtime_error("invalid PNG filter type");
+                }
+                row[i] = static_cast<uint8_t>(row[i] + predictor);
+            }
+        }
+
+        // sample index of the row scaled to [0, 1]; indices of palette images
+        // are returned unscaled
+        float sample(const uint8_t *row, size_t index) const
+        {
+            if(bitDepth_ == 16)
+                return ((row[2 * index] << 8) | row[2 * index + 1]) / 65535.0f;
+            if(bitDepth_ == 8)
+                return colorType_ == 3 ? row[index] : row[index] / 255.0f;
+
+            const size_t bit = index * bitDepth_;
+            const int maxValue = (1 << bitDepth_) - 1;
+            const int value = (row[bit / 8] >> (8 - bitDepth_ - bit % 8)) & maxValue;
+            return colorType_ == 3 ? static_cast<float>(value) : static_cast<float>(value) / maxValue;
+        }
+
+        Vec3 pixel(const uint8_t *row, int x) const
+        {
+            switch(colorType_)
+            {
+            case 0:
+                return Vec3(sample(row, x));
+            case 2:
+                return Vec3(sample(row, 3 * size_t(x)), sample(row, 3 * size_t(x) + 1),
+                            sample(row, 3 * size_t(x) + 2));
+            case 3:
+                {
+                    const size_t index = static_cast<size_t>(sample(row, x));
+                    if(index >= palette_.size())
+                        throw std::runtime_error("PNG palette index out of range");
+                    return palette_[index];
+                }
+            case 4:
+                return Vec3(sample(row, 2 * size_t(x)));
+            default:
+                return Vec3(sample(row, 4 * size_t(x)), sample(row, 4 * size_t(x) + 1),
+                            sample(row, 4 * size_t(x) + 2));
+            }
+        }
+
+        // feeds the following IDAT chunks to the inflater as it needs them
+        void inflateExactly(uint8_t *out, size_t size)
+        {
+            size_t filled = 0;
+            while(filled < size)
+            {
+                const size_t written = inflater_.inflate(out + filled, size - filled);
+                filled += written;
+                if(filled == size)
+                    break;
+                if(inflater_.finished())
+                    throw std::runtime_error("PNG image data ends early");
+                if(written == 0 && inflater_.needsInput())
+                {
+                    while(chunkRemaining_ == 0)
+                    {
+                        endChunk();
+                        nextChunk();
+                        if(chunkType_ != "IDAT")
+                            throw std::runtime_error("PNG image data ends early");
+                    }
+                    input_.resize(std::min<size_t>(chunkRemaining_, INPUT_SIZE));
+                    readChunkData(input_.data(), input_.size());
+                    inflater_.feed(input_.data(), input_.size());
+                }
+            }
+        }
+
+        void readBytes(uint8_t *data, size_t size)
+        {
+            in_.read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(size));
+            if(in_.gcount() != static_cast<std::streamsize>(size))
+                throw std::runtime_error("truncated PNG image");
+        }
+
+        void nextChunk()
+        {
+            uint8_t header[8];
+            readBytes(header, sizeof(header));
+            chunkRemaining_ = getBigEndian32(header);
+            if(chunkRemaining_ > 0x7fffffffu)
+                throw std::runtime_error("invalid PNG chunk length");
+            chunkType_.assign(header + 4, header + 8);
+            chunkCRC_ = crc32(0, header + 4, 4);
+        }
+
+        void readChunkData(uint8_t *data, size_t size)
+        {
+            readBytes(data, size);
+            chunkCRC_ = crc32(chunkCRC_, data, size);
+            chunkRemaining_ -= static_cast<uint32_t>(size);
+        }
+
+        // checks the CRC once the chunk data is read
+        void endChunk()
+        {
+            uint8_t crc[4];
+            readBytes(crc, sizeof(crc));
+            if(getBigEndian32(crc) != chunkCRC_)
+                throw std::runtime_error("PNG chunk " + chunkType_ + " fails its CRC check");
+        }
+
+        void skipChunk()
+        {
+            uint8_t buffer[4096];
+            while(chunkRemaining_ > 0)
+                readChunkData(buffer, std::min<size_t>(chunkRemaining_, sizeof(buffer)));
+            endChunk();
+        }
+
+        std::istream &in_;
+
+        int  width_        = 0;
+        int  height_       = 0;
+        int  bitDepth_     = 0;
+        int  colorType_    = 0;
+        int  bitsPerPixel_ = 0;
+        bool interlaced_   = false;
+
+        std::vector<Vec3> palette_;
+
+        std::string chunkType_;
+        uint32_t    chunkRemaining_ = 0;
+        uint32_t    chunkCRC_       = 0;
+
+        ZlibInflater         inflater_;
+        std::vector<uint8_t> input_;
+    };
+
+    // formats whose input agz-utils decodes
+    class AgzDecodedFormat : public ImageFormat
+    {
+    public:
+
+        // not streamed: agz-utils decodes from memory only, so the encoded
+        // image is buffered as a whole before decoding
+        Texture<Vec3> read(std::istream &in) const override
+        {
+            const std::vector<char> data(
+                (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            if(data.empty())
+                throw std::runtime_error("empty image stream");
+            return fromRGB8(agz::img::load_rgb_from_memory(data.data(), data.size()));
+        }
+
+        Texture<Vec3> load(const std::string &filename) const override
+        {
+            return fromRGB8(agz::img::load_rgb_from_file(filename));
+        }
+    };
+
+    // 8- or 16-bit output; input of either is decoded by PNGReader
+    class PNGFormatBase : public ImageFormat
+    {
+    public:
+
+        Texture<Vec3> read(std::istream &in) const override
+        {
+            return PNGReader(in).read();
+        }
+    };
+
+    class PNGFormat : public PNGFormatBase
+    {
+    public:
+
+        std::string name() const override { return "png"; }
+
+        std::vector<std::string> extensions() const override { return { "png" }; }
+
+        std::unique_ptr<ImageWriter> createWriter(
+            std::ostream &out, int width, int height, const ImageWriterOptions &options) const override
+        {
+            return std::make_unique<PNGWriter>(out, width, height, 8, options);
+        }
+    };
+
+    class PNG16Format : public PNGFormatBase
+    {
+    public:
+
+        std::string name() const override { return "png16"; }
+
+        std::vector<std::string> extensions() const override { return {}; }
+
+        std::unique_ptr<ImageWriter> createWriter(
+            std::ostream &out, int width, int height, const ImageWriterOptions &options) const override
+        {
+            return std::make_unique<PNGWriter>(out, width, height, 16, options);
+        }
+    };
+
+    class JPGFormat : public AgzDecodedFormat
+    {
+    public:
+
+        std::string name() const override { return "jpg"; }
+
+        std::vector<std::string> extensions() const override { return { "jpg", "jpeg" }; }
+
+        bool streamable() const noexcept override { return false; }
+
+        std::unique_ptr<ImageWriter> createWriter(
+            std::ostream &, int, int, const ImageWriterOptions &) const override
+        {
+            throw std::runtime_error("JPG images can only be written to files");
+        }
+
+        void save(
+            const std::string        &filename,
+            const Texture<Vec3>      &texture,
+            const ImageWriterOptions &) const override
+        {
+            agz::img::save_rgb_to_jpg_file(filename, texture.map([](const Vec3 &c)
+            {
+                return agz::math::to_color3b<float>(c);
+            }).get_data());
+        }
+    };
+
+    class BMPFormat : public AgzDecodedFormat
+    {
+    public:
+
+        std::string name() const override { return "bmp"; }
+
+        std::vector<std::string> extensions() const override { return { "bmp" }; }
+
+        std::unique_ptr<ImageWriter> createWriter(
+            std::ostream &out, int width, int height, const ImageWriterOptions &) const override
+        {
+            return std::make_unique<BMPWriter>(out, width, height);
+        }
+    };
+
+    class PPMFormat : public ImageFormat
+    {
+    public:
+
+        std::string name() const override { return "ppm"; }
+
+        std::vector<std::string> extensions() const override { return { "ppm" }; }
+
+        std::unique_ptr<ImageWriter> createWriter(
+            std::ostream &out, int width, int height, const ImageWriterOptions &) const override
+        {
+            return std::make_unique<PPMWriter>(out, width, height);
+        }
+
+        Texture<Vec3> read(std::istream &in) const override
+        {
+            return readPPM(in);
+        }
+    };
+
+    class PFMFormat : public ImageFormat
+    {
+    public:
+
+        std::string name() const override { return "pfm"; }
+
+        std::vector<std::string> extensions() const override { return { "pfm" }; }
+
+        std::unique_ptr<ImageWriter> createWriter(
+            std::ostream &out, int width, int height, const ImageWriterOptions &) const override
+        {
+            return std::make_unique<PFMWriter>(out, width, height);
+        }
+
+        Texture<Vec3> read(std::istream &in) const override
+        {
+            return readPFM(in);
+        }
+    };
+
+    class TiledHalfFormat : public ImageFormat
+    {
+    public:
+
+        std::string name() const override { return "hft"; }
+
+        std::vector<std::string> extensions() const override { return { "hft" }; }
+
+        std::unique_ptr<ImageWriter> createWriter(
+            std::ostream &out, int width, int height, const ImageWriterOptions &options) const override
+        {
+            return std::make_unique<TiledHalfWriter>(out, width, height, options.tileSize);
+        }
+
+        Texture<Vec3> read(std::istream &in) const override
+        {
+            return readTiledHalf(in);
+        }
+    };
+
+} // namespace anonymous
+
+Texture<Vec3> ImageFormat::load(const std::string &filename) const
+{
+    std::ifstream in(filename, std::ios::binary);
+    if(!in)
+        throw std::runtime_error("failed to open " + filename);
+    return read(in);
+}
+
+void ImageFormat::save(
+    const std::string        &filename,
+    const Texture<Vec3>      &texture,
+    const ImageWriterOptions &options) const
+{
+    auto writer = openImageWriter(filename, texture.width(), texture.height(), this, options);
+    for(int y = 0; y < texture.height(); ++y)
+        writer->writeRow(texture.raw_data() + size_t(y) * texture.width());
+    writer->finish();
+}
+
+ImageFormatRegistry::ImageFormatRegistry()
+{
+    add(std::make_shared<PNGFormat>());
+    add(std::make_shared<PNG16Format>());
+    add(std::make_shared<JPGFormat>());
+    add(std::make_shared<BMPFormat>());
+    add(std::make_shared<PPMFormat>());
+    add(std::make_shared<PFMFormat>());
+    add(std::make_shared<TiledHalfFormat>());
+}
+
+ImageFormatRegistry &ImageFormatRegistry::global()
+{
+    static ImageFormatRegistry registry;
+    return registry;
+}
+
+void ImageFormatRegistry::add(std::shared_ptr<const ImageFormat> format)
+{
+    formats_.erase(std::remove_if(formats_.begin(), formats_.end(),
+        [&](const std::shared_ptr<const ImageFormat> &existing)
+    {
+        return existing->name() == format->name();
+    }), formats_.end());
+
+    // later formats take precedence in find
+    formats_.push_back(std::move(format));
+}
+
+const ImageFormat &ImageFormatRegistry::find(const std::string &name) const
+{
+    const std::string lower = agz::stdstr::to_lower(name);
+
+    for(auto it = formats_.rbegin(); it != formats_.rend(); ++it)
+    {
+        if((*it)->name() == lower)
+            return **it;
+    }
+
+    for(auto it = formats_.rbegin(); it != formats_.rend(); ++it)
+    {
+        const auto extensions = (*it)->extensions();
+        if(std::find(extensions.begin(), extensions.end(), lower) != extensions.end())
+            return **it;
+    }
+
+    std::string known;
+    for(auto &format : names())
+        known += (known.empty() ? "" : ", ") + format;
+    throw std::runtime_error("unsupported image format: " + name + " (known: " + known + ")");
+}
+
+const ImageFormat &ImageFormatRegistry::ofFile(const std::string &filename) const
+{
+    const size_t dot = filename.rfind('.');
+    if(dot == std::string::npos)
+        throw std::runtime_error("unsupported image format: " + filename);
+    return find(filename.substr(dot + 1));
+}
+
+std::vector<std::string> ImageFormatRegistry::names() const
+{
+    std::vector<std::string> result;
+    for(auto &format : formats_)
+        result.push_back(format->name());
+    return result;
+}
+
+const ImageFormat &parseImageFormat(const std::string &name)
+{
+    return ImageFormatRegistry::global().find(name);
+}
+
+const ImageFormat &imageFormatOfFile(const std::string &filename)
+{
+    return ImageFormatRegistry::global().ofFile(filename);
+}
+
+std::unique_ptr<ImageWriter> createImageWriter(
+    const ImageFormat        &format,
+    std::ostream             &out,
+    int                       width,
+    int                       height,
+    const ImageWriterOptions &options)
+{
+    return format.createWriter(out, width, height, options);
+}
+
+std::unique_ptr<ImageWriter> openImageWriter(
+    const std::string        &filename,
+    int                       width,
+    int                       height,
+    const ImageFormat        *format,
+    const ImageWriterOptions &options)
+{
+    if(filename == "-")
+    {
+        if(!format)
+            throw std::runtime_error("writing an image to stdout needs an explicit format");
+        setBinaryMode(stdout);
+        return format->createWriter(std::cout, width, height, options);
+    }
+
+    if(!format)
+        format = &imageFormatOfFile(filename);
+    if(!format->streamable())
+        throw std::runtime_error(format->name() + " images are only saved as a whole and have no writer");
+
+    agz::file::create_directory_for_file(filename);
+
+    auto file = std::make_unique<std::ofstream>(filename, std::ios::binary);
+    if(!*file)
+        throw std::runtime_error("failed to open " + filename);
+
+    auto writer = format->createWriter(*file, width, height, options);
+    return std::make_unique<FileImageWriter>(std::move(file), std::move(writer));
+}
+
+Texture<Vec3> readImage(std::istream &in, const ImageFormat &format)
+{
+    return format.read(in);
+}
+
+Texture<Vec3> loadImage(
+    const std::string &filename,
+    const ImageFormat *format)
+{
+    if(filename == "-")
+    {
+        if(!format)
+            throw std::runtime_error("reading an image from stdin needs an explicit format");
+        setBinaryMode(stdin);
+        return format->read(std::cin);
+    }
+
+    if(!format)
+        format = &imageFormatOfFile(filename);
+    return format->load(filename);
+}
+
+void saveImage(
+    const std::string        &filename,
+    const Texture<Vec3>      &texture,
+    const ImageFormat        *format,
+    const ImageWriterOptions &options)
+{
+    if(filename == "-")
+    {
+        auto writer = openImageWriter(filename, texture.width(), texture.height(), format, options);
+        for(int y = 0; y < texture.height(); ++y)
+            writer->writeRow(texture.raw_data() + size_t(y) * texture.width());
+        writer->finish();
+        return;
+    }
+
+    if(!format)
+        format = &imageFormatOfFile(filename);
+
+    agz::file::create_directory_for_file(filename);
+    format->save(filename, texture, options);
+}
@@ -0,0 +1,148 @@
+#include "../include/LazyQuilter.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    int floorDiv(int a, int b) noexcept
+    {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    uint64_t tileKey(int tileX, int tileY) noexcept
+    {
+        return (uint64_t(uint32_t(tileX)) << 32) | uint32_t(tileY);
+    }
+}
+
+LazyQuilter::LazyQuilter(
+    const TextureQuilter &quilter,
+    Texture<Vec3>         source,
+    size_t                cacheBytes)
+    : quilter_(quilter), source_(std::move(source)),
+      resolvedTileCount_(0)
+{
+    const int tileWidth  = quilter_.tileWidth_;
+    const int tileHeight = quilter_.tileHeight_;
+
+    if(tileWidth < 2 * quilter_.seamWidth_ || tileHeight < 2 * quilter_.seamHeight_)
+        throw std::runtime_error("lazy quilting needs tiles at least twice as large as the seams");
+    if(source_.width() <= tileWidth || source_.height() <= tileHeight)
+        throw std::runtime_error("source is not larger than one tile");
+
+    sourceLum_ = LuminancePlane(source_);
+    seed_ = quilter_.seed_ ? *quilter_.seed_ : std::random_device()();
+
+    stepX_ = tileWidth - quilter_.seamWidth_;
+    stepY_ = tileHeight - quilter_.seamHeight_;
+
+    // resolving a tile resolves up to three phases of neighbours around it,
+    // which should stay cached meanwhile
+    const size_t tileBytes = sizeof(ResolvedTile) + sizeof(CacheEntry)
+                           + 4 * sizeof(void*) + tileWidth * tileHeight;
+    maxCachedTiles_ = std::max<size_t>(64, cacheBytes / tileBytes);
+}
+
+Texture<Vec3> LazyQuilter::getRegion(int x0, int y0, int width, int height)
+{
+    if(x0 < 0 || y0 < 0)
+        throw std::runtime_error("region must not start at negative coordinates");
+    if(width <= 0 || height <= 0)
+        throw std::runtime_error("region must not be empty");
+
+    Texture<Vec3> region(height, width);
+    composite(region, x0, y0, width, height, 4);
+    return region;
+}
+
+int LazyQuilter::phaseOf(int tileX, int tileY) noexcept
+{
+    return (tileX & 1) + 2 * (tileY & 1);
+}
+
+std::shared_ptr<const LazyQuilter::ResolvedTile> LazyQuilter::resolveTile(int tileX, int tileY)
+{
+    const uint64_t key = tileKey(tileX, tileY);
+    if(auto it = cache_.find(key); it != cache_.end())
+    {
+        lru_.splice(lru_.begin(), lru_, it->second.lruPosition);
+        return it->second.tile;
+    }
+
+    const int tileWidth  = quilter_.tileWidth_;
+    const int tileHeight = quilter_.tileHeight_;
+    const int phase = phaseOf(tileX, tileY);
+
+    Texture<Vec3> footprint(tileHeight, tileWidth);
+    composite(footprint, tileX * stepX_, tileY * stepY_, tileWidth, tileHeight, phase);
+
+    TextureQuilter::ConstrainedTile constrained;
+    constrained.left   = constrained.right  = phase == 1 || phase == 3;
+    constrained.top    = constrained.bottom = phase == 2 || phase == 3;
+
+    std::seed_seq seedSeq{
+        seed_, static_cast<unsigned>(tileX), static_cast<unsigned>(tileY) };
+    std::default_random_engine rng(seedSeq);
+
+    auto tile = std::make_shared<ResolvedTile>();
+    tile->source = quilter_.selectConstrainedSourceTile(
+        source_, sourceLum_, footprint, constrained, rng);
+    quilter_.placeConstrainedTile(
+        source_, footprint, tile->source, constrained, &tile->coverage);
+    ++resolvedTileCount_;
+
+    lru_.push_front(key);
+    cache_[key] = { tile, lru_.begin() };
+
+    while(cache_.size() > maxCachedTiles_)
+    {
+        cache_.erase(lru_.back());
+        lru_.pop_back();
+    }
+
+    return tile;
+}
+
+void LazyQuilter::composite(
+    Texture<Vec3> &target,
+    int x0, int y0, int width, int height,
+    int endPhase)
+{
+    const int tileWidth  = quilter_.tileWidth_;
+    const int tileHeight = quilter_.tileHeight_;
+
+    const int tileXBeg = std::max(0, floorDiv(x0 - tileWidth, stepX_) + 1);
+    const int tileYBeg = std::max(0, floorDiv(y0 - tileHeight, stepY_) + 1);
+    const int tileXEnd = floorDiv(x0 + width - 1, stepX_) + 1;
+    const int tileYEnd = floorDiv(y0 + height - 1, stepY_) + 1;
+
+    for(int phase = 0; phase < endPhase; ++phase)
+    {
+        for(int tileY = tileYBeg; tileY < tileYEnd; ++tileY)
+        {
+            for(int tileX = tileXBeg; tileX < tileXEnd; ++tileX)
+            {
+                if(phaseOf(tileX, tileY) != phase)
+                    continue;
+
+                const auto tile = resolveTile(tileX, tileY);
+
+                const int x = tileX * stepX_, y = tileY * stepY_;
+                const int yBeg = std::max(y, y0), yEnd = std::min(y + tileHeight, y0 + height);
+                const int xBeg = std::max(x, x0), xEnd = std::min(x + tileWidth, x0 + width);
+
+                for(int yi = yBeg; yi < yEnd; ++yi)
+                {
+                    for(int xi = xBeg; xi < xEnd; ++xi)
+                    {
+                        if(tile->coverage[(yi - y) * tileWidth + xi - x])
+                        {
+                            target(yi - y0, xi - x0) = source_(
+                                tile->source.y + yi - y, tile->source.x + xi - x);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#include "../include/LuminanceStatistics.h"
+
+LuminancePlane::LuminancePlane(const Texture<Vec3> &texture)
+{
+    initialize(texture.width(), texture.height());
+    update(texture, 0, 0, width_, height_);
+}
+
+void LuminancePlane::initialize(int width, int height)
+{
+    width_  = width;
+    height_ = height;
+    data_.assign(static_cast<size_t>(width) * height, 0.0f);
+}
+
+FixedPointLuminancePlane::FixedPointLuminancePlane(const Texture<Vec3> &texture)
+{
+    initialize(texture.width(), texture.height());
+    update(texture, 0, 0, width_, height_);
+}
+
+void FixedPointLuminancePlane::initialize(int width, int height)
+{
+    width_  = width;
+    height_ = height;
+    data_.assign(static_cast<size_t>(width) * height, 0);
+}
+
+SourceStatistics::SourceStatistics(const Texture<Vec3> &source)
+    : lum_(source)
+{
+    const int w = lum_.width(), h = lum_.height();
+    sat_.assign(static_cast<size_t>(w + 1) * (h + 1), 0.0);
+
+    for(int y = 0; y < h; ++y)
+    {
+        const float *lumRow = lum_.row(y);
+        const double *above = &sat_[y * (w + 1)];
+        double *current = &sat_[(y + 1) * (w + 1)];
+
+        double rowSum = 0;
+        for(int x = 0; x < w; ++x)
+        {
+            rowSum += static_cast<double>(lumRow[x]) * lumRow[x];
+            current[x + 1] = above[x + 1] + rowSum;
+        }
+    }
+}
+
+double SourceStatistics::squaredSum(
+    int x, int y, int width, int height) const noexcept
+{
+    return sat(y + height, x + width) - sat(y, x + width)
+         - sat(y + height, x)         + sat(y, x);
+}
+
+size_t SourceStatistics::byteSize() const noexcept
+{
+    return lum_.byteSize() + sat_.size() * sizeof(double);
+}
+
+TargetStatistics::TargetStatistics(int width, int height, int blockWidth)
+    : blockWidth_(blockWidth)
+{
+    lum_.initialize(width, height);
+    rowPrefix_.assign(static_cast<size_t>(width) * height, 0.0);
+}
+
+double TargetStatistics::squaredSum(
+    int x, int y, int width, int height) const noexcept
+{
+    double result = 0;
+    for(int yi = y; yi < y + height; ++yi)
+    {
+        const double *prefix = &rowPrefix_[static_cast<size_t>(yi) * lum_.width()];
+
+        // one difference of prefixes per block the range overlaps
+        for(int xi = x; xi < x + width;)
+        {
+            const int blockBegin = xi - xi % blockWidth_;
+            const int last = (std::min)(x + width, blockBegin + blockWidth_) - 1;
+
+            result += prefix[last] - (xi > blockBegin ? prefix[xi - 1] : 0.0);
+            xi = last + 1;
+        }
+    }
+    return result;
+}
+
+size_t TargetStatistics::byteSize() const noexcept
+{
+    return lum_.byteSize() + rowPrefix_.size() * sizeof(double);
+}
@@ -0,0 +1,45 @@
+#include "../include/MipPyramid.h"
+#include <algorithm>
+
+MipPyramid::MipPyramid(const Texture<Vec3> &base, int levelCount)
+{
+    const int fullCount = fullLevelCount(base.width(), base.height());
+    levelCount = levelCount > 0 ? std::min(levelCount, fullCount) : fullCount;
+
+    levels_.reserve(levelCount);
+    levels_.push_back(base);
+
+    while(static_cast<int>(levels_.size()) < levelCount)
+    {
+        const Texture<Vec3> &src = levels_.back();
+        const int width  = std::max(1, src.width() / 2);
+        const int height = std::max(1, src.height() / 2);
+
+        Texture<Vec3> dst(height, width, agz::UNINIT);
+        for(int y = 0; y < height; ++y)
+        {
+            const int y0 = std::min(2 * y, src.height() - 1);
+            const int y1 = std::min(2 * y + 1, src.height() - 1);
+            for(int x = 0; x < width; ++x)
+            {
+                const int x0 = std::min(2 * x, src.width() - 1);
+                const int x1 = std::min(2 * x + 1, src.width() - 1);
+                dst(y, x) = (src(y0, x0) + src(y0, x1) + src(y1, x0) + src(y1, x1)) * 0.25f;
+            }
+        }
+
+        levels_.push_back(std::move(dst));
+    }
+}
+
+int MipPyramid::fullLevelCount(int width, int height) noexcept
+{
+    int count = 1;
+    while(width > 1 || height > 1)
+    {
+        width  = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        ++count;
+    }
+    return count;
+}
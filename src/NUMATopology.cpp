@@ -0,0 +1,176 @@
+#include "../include/NUMATopology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+    // parses cpulist syntax, e.g. "0-3,8-11"
+    std::vector<int> parseCPUList(const std::string &list)
+    {
+        std::vector<int> result;
+
+        std::istringstream in(list);
+        std::string range;
+        while(std::getline(in, range, ','))
+        {
+            if(range.empty() || range == "\n")
+                continue;
+
+            const size_t dash = range.find('-');
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ?
+                first : std::stoi(range.substr(dash + 1));
+
+            for(int cpu = first; cpu <= last; ++cpu)
+                result.push_back(cpu);
+        }
+
+        return result;
+    }
+
+#ifdef __linux__
+    const char *NODE_DIRECTORY = "/sys/devices/system/node";
+
+    std::vector<int> listNodeIDs()
+    {
+        std::vector<int> result;
+
+        DIR *dir = opendir(NODE_DIRECTORY);
+        if(!dir)
+            return result;
+
+        while(const dirent *entry = readdir(dir))
+        {
+            const std::string name = entry->d_name;
+            if(name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+               std::all_of(name.begin() + 4, name.end(), ::isdigit))
+                result.push_back(std::stoi(name.substr(4)));
+        }
+        closedir(dir);
+
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // "Node 0 MemTotal:       65842092 kB"
+    uint64_t readNodeMemory(int id)
+    {
+        std::ifstream fin(std::string(NODE_DIRECTORY) +
+                          "/node" + std::to_string(id) + "/meminfo");
+
+        std::string line;
+        while(std::getline(fin, line))
+        {
+            const size_t pos = line.find("MemTotal:");
+            if(pos == std::string::npos)
+                continue;
+
+            std::istringstream in(line.substr(pos + 9));
+            uint64_t kilobytes = 0;
+            in >> kilobytes;
+            return kilobytes * 1024;
+        }
+
+        return 0;
+    }
+#endif
+}
+
+NUMATopology NUMATopology::detect()
+{
+    NUMATopology result;
+
+#ifdef __linux__
+    for(int id : listNodeIDs())
+    {
+        std::ifstream fin(std::string(NODE_DIRECTORY) +
+                          "/node" + std::to_string(id) + "/cpulist");
+        std::string cpuList;
+        std::getline(fin, cpuList);
+
+        NUMANode node;
+        node.id          = id;
+        node.cpus        = parseCPUList(cpuList);
+        node.memoryBytes = readNodeMemory(id);
+
+        // memory-only nodes cannot run workers
+        if(!node.cpus.empty())
+            result.nodes_.push_back(std::move(node));
+    }
+#endif
+
+    if(result.nodes_.empty())
+    {
+        NUMANode node;
+        const int cpuCount = static_cast<int>(
+            (std::max)(1u, std::thread::hardware_concurrency()));
+        for(int cpu = 0; cpu < cpuCount; ++cpu)
+            node.cpus.push_back(cpu);
+        result.nodes_.push_back(std::move(node));
+    }
+
+    return result;
+}
+
+int NUMATopology::cpuCount() const noexcept
+{
+    int result = 0;
+    for(auto &node : nodes_)
+        result += static_cast<int>(node.cpus.size());
+    return result;
+}
+
+int NUMATopology::nodeOfCPU(int cpu) const noexcept
+{
+    for(int i = 0; i < nodeCount(); ++i)
+    {
+        auto &cpus = nodes_[i].cpus;
+        if(std::find(cpus.begin(), cpus.end(), cpu) != cpus.end())
+            return i;
+    }
+    return -1;
+}
+
+void NUMATopology::writeReport(std::ostream &out) const
+{
+    out << "NUMA nodes: " << nodeCount() << ", CPUs: " << cpuCount() << "\n";
+
+    for(auto &node : nodes_)
+    {
+        out << "  node " << node.id << ": " << node.cpus.size() << " CPUs (";
+        for(size_t i = 0; i < node.cpus.size(); ++i)
+            out << (i ? "," : "") << node.cpus[i];
+        out << ")";
+
+        if(node.memoryBytes)
+            out << ", " << (node.memoryBytes >> 20) << " MiB";
+        out << "\n";
+    }
+}
+
+bool pinCurrentThreadToCPU(int cpu) noexcept
+{
+#ifdef __linux__
+    if(cpu < 0 || cpu >= CPU_SETSIZE)
+        return false;
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
@@ -0,0 +1,68 @@
+#include "../include/PerfEventCounter.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+PerfEventCounter::PerfEventCounter(Event event) noexcept
+    : fd_(-1)
+{
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = PERF_TYPE_HW_CACHE;
+    attr.disabled       = 1;
+    attr.inherit        = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    const uint64_t result = event == Event::DTLBLoadMisses ?
+        PERF_COUNT_HW_CACHE_RESULT_MISS : PERF_COUNT_HW_CACHE_RESULT_ACCESS;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB
+                | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (result << 16);
+
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+    (void)event;
+#endif
+}
+
+PerfEventCounter::~PerfEventCounter()
+{
+#ifdef __linux__
+    if(fd_ >= 0)
+        close(fd_);
+#endif
+}
+
+void PerfEventCounter::start() noexcept
+{
+#ifdef __linux__
+    if(fd_ < 0)
+        return;
+    ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+uint64_t PerfEventCounter::stop() noexcept
+{
+#ifdef __linux__
+    if(fd_ < 0)
+        return 0;
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+
+    uint64_t count = 0;
+    if(read(fd_, &count, sizeof(count)) != sizeof(count))
+        return 0;
+    return count;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,111 @@
+#include "../include/ProgressReporter.h"
+#include <agz-utils/console.h>
+
+struct TTYProgressReporter::Impl
+{
+    agz::console::progress_bar_t pbar;
+    int                          displayed;
+
+    explicit Impl(int totalTiles)
+        : pbar(totalTiles, 80, '='), displayed(0)
+    {
+
+    }
+};
+
+void TTYProgressReporter::begin(int totalTiles)
+{
+    impl_ = std::make_shared<Impl>(totalTiles);
+    impl_->pbar.display();
+}
+
+void TTYProgressReporter::update(int placedTiles, int)
+{
+    for(; impl_->displayed < placedTiles; ++impl_->displayed)
+        ++impl_->pbar;
+    impl_->pbar.display();
+}
+
+void TTYProgressReporter::end(int totalTiles)
+{
+    update(totalTiles, totalTiles);
+    impl_->pbar.done();
+    impl_.reset();
+}
+
+JSONLinesProgressReporter::JSONLinesProgressReporter(std::ostream &out)
+    : out_(out)
+{
+
+}
+
+void JSONLinesProgressReporter::begin(int totalTiles)
+{
+    start_ = std::chrono::steady_clock::now();
+    out_ << "{\"event\":\"begin\",\"total\":" << totalTiles << "}"
+         << std::endl;
+}
+
+void JSONLinesProgressReporter::update(int placedTiles, int totalTiles)
+{
+    out_ << "{\"event\":\"progress\",\"placed\":" << placedTiles
+         << ",\"total\":" << totalTiles
+         << ",\"elapsed_ms\":" << elapsedMs() << "}" << std::endl;
+}
+
+void JSONLinesProgressReporter::end(int totalTiles)
+{
+    out_ << "{\"event\":\"end\",\"total\":" << totalTiles
+         << ",\"elapsed_ms\":" << elapsedMs() << "}" << std::endl;
+}
+
+double JSONLinesProgressReporter::elapsedMs() const
+{
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start_).count();
+}
+
+ProgressMonitor::ProgressMonitor(
+    ProgressReporter          *reporter,
+    int                        totalTiles,
+    std::chrono::milliseconds  interval)
+    : reporter_(reporter), totalTiles_(totalTiles), interval_(interval),
+      placedTiles_(0), stop_(false)
+{
+    if(reporter_)
+    {
+        reporter_->begin(totalTiles_);
+        thread_ = std::thread(&ProgressMonitor::run, this);
+    }
+}
+
+ProgressMonitor::~ProgressMonitor()
+{
+    if(!reporter_)
+        return;
+
+    {
+        std::lock_guard lk(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+
+    reporter_->end(totalTiles_);
+}
+
+void ProgressMonitor::run()
+{
+    int reported = 0;
+
+    std::unique_lock lk(mutex_);
+    while(!cond_.wait_for(lk, interval_, [&] { return stop_; }))
+    {
+        const int placed = placedTiles_.load(std::memory_order_relaxed);
+        if(placed != reported)
+        {
+            reporter_->update(placed, totalTiles_);
+            reported = placed;
+        }
+    }
+}
@@ -0,0 +1,346 @@
+#include "../include/QuiltMap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    const char     MAP_MAGIC[4] = { 'Q', 'M', 'A', 'P' };
+    const uint32_t MAP_VERSION  = 2;
+
+    const int MIP_CHUNK_ROWS = 16;
+
+    template<typename T>
+    void writeValue(std::ostream &out, const T &value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void writeArray(std::ostream &out, const std::vector<T> &values)
+    {
+        writeValue(out, static_cast<uint64_t>(values.size()));
+        out.write(reinterpret_cast<const char*>(values.data()), sizeof(T) * values.size());
+    }
+
+    template<typename T>
+    void readValue(std::istream &in, T &value)
+    {
+        if(!in.read(reinterpret_cast<char*>(&value), sizeof(T)))
+            throw std::runtime_error("truncated quilt map");
+    }
+
+    template<typename T>
+    void readArray(std::istream &in, std::vector<T> &values, size_t expectedSize)
+    {
+        uint64_t size;
+        readValue(in, size);
+        if(size != expectedSize)
+            throw std::runtime_error("invalid quilt map array size");
+
+        values.resize(expectedSize);
+        if(!in.read(reinterpret_cast<char*>(values.data()), sizeof(T) * expectedSize))
+            throw std::runtime_error("truncated quilt map");
+    }
+}
+
+agz::math::vec2i QuiltMap::renderSize(int srcWidth, int srcHeight) const noexcept
+{
+    if(srcWidth == sourceWidth && srcHeight == sourceHeight)
+        return { targetWidth, targetHeight };
+
+    return {
+        std::max(1, static_cast<int>(std::lround(
+            static_cast<double>(targetWidth) * srcWidth / sourceWidth))),
+        std::max(1, static_cast<int>(std::lround(
+            static_cast<double>(targetHeight) * srcHeight / sourceHeight)))
+    };
+}
+
+void QuiltMap::renderRow(const Texture<Vec3> &source, int y, Vec3 *row) const
+{
+    const agz::math::vec2i size = renderSize(source.width(), source.height());
+    renderRow(source, size.x, size.y, y, row);
+}
+
+void QuiltMap::renderRow(
+    const Texture<Vec3> &source,
+    int                  outputWidth,
+    int                  outputHeight,
+    int                  y,
+    Vec3                *row) const
+{
+    const double outputScaleX = static_cast<double>(outputWidth) / targetWidth;
+    const double outputScaleY = static_cast<double>(outputHeight) / targetHeight;
+    const double sourceScaleX = static_cast<double>(source.width()) / sourceWidth;
+    const double sourceScaleY = static_cast<double>(source.height()) / sourceHeight;
+
+    const int stepX = tileWidth - seamWidth;
+    const int stepY = tileHeight - seamHeight;
+
+    // output pixel centre in map target coordinates
+    const double mapYf = (y + 0.5) / outputScaleY;
+    const int mapY = std::min(targetHeight - 1, static_cast<int>(mapYf));
+    const int lastTileY = std::min(tileCountY - 1, mapY / stepY);
+
+    for(int x = 0; x < outputWidth; ++x)
+    {
+        const double mapXf = (x + 0.5) / outputScaleX;
+        const int mapX = std::min(targetWidth - 1, static_cast<int>(mapXf));
+        const int lastTileX = std::min(tileCountX - 1, mapX / stepX);
+
+        // the pixel belongs to the last tile in raster order covering it and
+        // keeping it; the first one covering it always keeps it
+        int ownerX = lastTileX, ownerY = lastTileY;
+        bool found = false;
+
+        for(int tileY = lastTileY; tileY >= 0 && tileY * stepY + tileHeight > mapY && !found; --tileY)
+        {
+            const int yi = mapY - tileY * stepY;
+            for(int tileX = lastTileX; tileX >= 0 && tileX * stepX + tileWidth > mapX; --tileX)
+            {
+                const int xi = mapX - tileX * stepX;
+                const int index = tileY * tileCountX + tileX;
+
+                ownerX = tileX;
+                ownerY = tileY;
+                if(leftSeams[index * tileHeight + yi] <= xi &&
+                   topSeams[index * tileWidth + xi] <= yi)
+                {
+                    found = true;
+                    break;
+                }
+            }
+        }
+
+        // position in the (transformed) source at the map's resolution
+        const agz::math::vec2i &src = sources[ownerY * tileCountX + ownerX];
+        const int transform = slotWidth ? src.x / slotWidth : 0;
+
+        double sourceX = src.x - transform * slotWidth + mapXf - ownerX * stepX;
+        double sourceY = src.y + mapYf - ownerY * stepY;
+        if(transform)
+        {
+            DihedralTransform(transform, sourceWidth, sourceHeight).sourcePoint(
+                sourceX, sourceY, sourceX, sourceY);
+        }
+
+        // bilinear, which reads a single texel when the position falls on a
+        // texel centre, as it always does at the map's own resolution
+        const double u = sourceX * sourceScaleX - 0.5;
+        const double v = sourceY * sourceScaleY - 0.5;
+
+        const int u0 = static_cast<int>(std::floor(u));
+        const int v0 = static_cast<int>(std::floor(v));
+        const float fu = static_cast<float>(u - u0);
+        const float fv = static_cast<float>(v - v0);
+
+        auto texel = [&](int tx, int ty)
+        {
+            return source(
+                std::clamp(ty, 0, source.height() - 1),
+                std::clamp(tx, 0, source.width() - 1));
+        };
+
+        if(fu == 0 && fv == 0)
+            row[x] = texel(u0, v0);
+        else
+        {
+            row[x] = (texel(u0, v0)     * (1 - fu) + texel(u0 + 1, v0)     * fu) * (1 - fv)
+                   + (texel(u0, v0 + 1) * (1 - fu) + texel(u0 + 1, v0 + 1) * fu) * fv;
+        }
+    }
+}
+
+Texture<Vec3> QuiltMap::render(const Texture<Vec3> &source) const
+{
+    const agz::math::vec2i size = renderSize(source.width(), source.height());
+
+    Texture<Vec3> result(size.y, size.x, agz::UNINIT);
+    for(int y = 0; y < size.y; ++y)
+        renderRow(source, y, result.raw_data() + y * size.x);
+    return result;
+}
+
+void QuiltMap::renderMipLevels(
+    const MipPyramid &sourceLevels,
+    int               threadCount,
+    const MipRowSink &sink) const
+{
+    const Texture<Vec3> &base = sourceLevels.level(0);
+    const agz::math::vec2i size = renderSize(base.width(), base.height());
+
+    struct Chunk
+    {
+        int level, width, height, yBeg, yEnd;
+    };
+
+    std::vector<Chunk> chunks;
+    for(int level = 0; level < sourceLevels.levelCount(); ++level)
+    {
+        const int width  = std::max(1, size.x >> level);
+        const int height = std::max(1, size.y >> level);
+        for(int y = 0; y < height; y += MIP_CHUNK_ROWS)
+            chunks.push_back({ level, width, height, y, std::min(y + MIP_CHUNK_ROWS, height) });
+    }
+
+    // chunks are taken in order, so the one a worker waits for to be emitted
+    // is always being rendered by another worker
+    std::atomic<size_t>     nextChunk = 0;
+    size_t                  emittedChunks = 0;
+    bool                    failed = false;
+    std::exception_ptr      error;
+    std::mutex              mutex;
+    std::condition_variable emitted;
+
+    auto work = [&]
+    {
+        std::vector<Vec3> rows;
+        for(size_t index = nextChunk++; index < chunks.size(); index = nextChunk++)
+        {
+            const Chunk &chunk = chunks[index];
+            try
+            {
+                rows.resize(size_t(chunk.width) * (chunk.yEnd - chunk.yBeg));
+                for(int y = chunk.yBeg; y < chunk.yEnd; ++y)
+                {
+                    renderRow(sourceLevels.level(chunk.level), chunk.width, chunk.height,
+                              y, &rows[size_t(y - chunk.yBeg) * chunk.width]);
+                }
+
+                std::unique_lock lock(mutex);
+                emitted.wait(lock, [&] { return failed || emittedChunks == index; });
+                if(failed)
+                    return;
+
+                for(int y = chunk.yBeg; y < chunk.yEnd; ++y)
+                    sink(chunk.level, y, &rows[size_t(y - chunk.yBeg) * chunk.width], chunk.width);
+
+                ++emittedChunks;
+                emitted.notify_all();
+            }
+            catch(...)
+            {
+                std::lock_guard lock(mutex);
+                if(!failed)
+                    error = std::current_exception();
+                failed = true;
+                emitted.notify_all();
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(int i = 1; i < threadCount; ++i)
+        threads.emplace_back(work);
+    work();
+
+    for(auto &thread : threads)
+        thread.join();
+
+    if(error)
+        std::rethrow_exception(error);
+}
+
+std::vector<Texture<Vec3>> QuiltMap::renderMipChain(
+    const MipPyramid &sourceLevels,
+    int               threadCount) const
+{
+    const Texture<Vec3> &base = sourceLevels.level(0);
+    const agz::math::vec2i size = renderSize(base.width(), base.height());
+
+    std::vector<Texture<Vec3>> levels;
+    for(int level = 0; level < sourceLevels.levelCount(); ++level)
+    {
+        levels.emplace_back(
+            std::max(1, size.y >> level), std::max(1, size.x >> level), agz::UNINIT);
+    }
+
+    renderMipLevels(sourceLevels, threadCount,
+        [&](int level, int y, const Vec3 *row, int width)
+    {
+        std::copy(row, row + width, levels[level].raw_data() + size_t(y) * width);
+    });
+
+    return levels;
+}
+
+void QuiltMap::write(std::ostream &out) const
+{
+    out.write(MAP_MAGIC, sizeof(MAP_MAGIC));
+    writeValue(out, MAP_VERSION);
+
+    for(int value : { tileWidth, tileHeight, seamWidth, seamHeight,
+                      targetWidth, targetHeight, sourceWidth, sourceHeight,
+                      tileCountX, tileCountY, slotWidth })
+        writeValue(out, static_cast<int32_t>(value));
+
+    writeArray(out, sources);
+    writeArray(out, leftSeams);
+    writeArray(out, topSeams);
+}
+
+QuiltMap QuiltMap::read(std::istream &in)
+{
+    char magic[sizeof(MAP_MAGIC)];
+    uint32_t version;
+    if(!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAP_MAGIC, sizeof(magic)))
+        throw std::runtime_error("invalid quilt map");
+    readValue(in, version);
+    if(version < 1 || version > MAP_VERSION)
+        throw std::runtime_error("unsupported quilt map version: " + std::to_string(version));
+
+    QuiltMap map;
+    for(int *value : { &map.tileWidth, &map.tileHeight, &map.seamWidth, &map.seamHeight,
+                       &map.targetWidth, &map.targetHeight, &map.sourceWidth, &map.sourceHeight,
+                       &map.tileCountX, &map.tileCountY })
+    {
+        int32_t v;
+        readValue(in, v);
+        *value = v;
+    }
+
+    // version 1 maps predate transformed candidates
+    if(version >= 2)
+    {
+        int32_t v;
+        readValue(in, v);
+        map.slotWidth = v;
+    }
+
+    if(map.tileCountX <= 0 || map.tileCountY <= 0 ||
+       map.tileWidth <= map.seamWidth || map.tileHeight <= map.seamHeight ||
+       map.sourceWidth <= 0 || map.sourceHeight <= 0)
+        throw std::runtime_error("invalid quilt map tile grid");
+
+    const size_t tileCount = size_t(map.tileCountX) * map.tileCountY;
+    readArray(in, map.sources, tileCount);
+    readArray(in, map.leftSeams, tileCount * map.tileHeight);
+    readArray(in, map.topSeams, tileCount * map.tileWidth);
+    return map;
+}
+
+void QuiltMap::save(const std::string &filename) const
+{
+    std::ofstream fout(filename, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+    if(!fout)
+        throw std::runtime_error("failed to open quilt map file: " + filename);
+    write(fout);
+}
+
+QuiltMap QuiltMap::load(const std::string &filename)
+{
+    std::ifstream fin(filename, std::ifstream::in | std::ifstream::binary);
+    if(!fin)
+        throw std::runtime_error("failed to open quilt map file: " + filename);
+    return read(fin);
+}
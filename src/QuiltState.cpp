@@ -0,0 +1,93 @@
+#include "../include/QuiltState.h"
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    const char *STATE_HEADER = "quilt-state";
+    const int   STATE_VERSION = 1;
+}
+
+void QuiltState::write(std::ostream &out) const
+{
+    out << STATE_HEADER << " " << STATE_VERSION << "\n";
+    out << tileWidth << " " << tileHeight << " "
+        << seamWidth << " " << seamHeight << "\n";
+    out << seed << "\n";
+    out << targetWidth << " " << targetHeight << "\n";
+    out << tileCountX << " " << tileCountY << "\n";
+
+    out << std::setprecision(std::numeric_limits<float>::max_digits10);
+    for(auto &record : tiles)
+    {
+        out << record.source.x << " " << record.source.y << " "
+            << record.referenceMSE << " "
+            << record.bestCandidate.x << " " << record.bestCandidate.y << " "
+            << record.bestMSE << " "
+            << record.evaluatedCandidates << " "
+            << record.goodCandidates.size();
+        for(auto &candidate : record.goodCandidates)
+            out << " " << candidate.x << " " << candidate.y;
+        out << "\n";
+    }
+}
+
+QuiltState QuiltState::read(std::istream &in)
+{
+    std::string header;
+    int version = 0;
+    in >> header >> version;
+    if(!in || header != STATE_HEADER)
+        throw std::runtime_error("invalid quilt state");
+    if(version != STATE_VERSION)
+        throw std::runtime_error("unsupported quilt state version: " + std::to_string(version));
+
+    QuiltState state;
+    in >> state.tileWidth >> state.tileHeight >> state.seamWidth >> state.seamHeight;
+    in >> state.seed;
+    in >> state.targetWidth >> state.targetHeight;
+    in >> state.tileCountX >> state.tileCountY;
+    if(!in || state.tileCountX <= 0 || state.tileCountY <= 0)
+        throw std::runtime_error("invalid quilt state tile grid");
+
+    state.tiles.resize(state.tileCountX * state.tileCountY);
+    for(auto &record : state.tiles)
+    {
+        size_t goodCount = 0;
+        in >> record.source.x >> record.source.y
+           >> record.referenceMSE
+           >> record.bestCandidate.x >> record.bestCandidate.y
+           >> record.bestMSE
+           >> record.evaluatedCandidates
+           >> goodCount;
+        if(!in)
+            throw std::runtime_error("truncated quilt state");
+
+        record.goodCandidates.resize(goodCount);
+        for(auto &candidate : record.goodCandidates)
+            in >> candidate.x >> candidate.y;
+    }
+
+    if(!in)
+        throw std::runtime_error("truncated quilt state");
+    return state;
+}
+
+void QuiltState::save(const std::string &filename) const
+{
+    std::ofstream fout(filename, std::ofstream::out | std::ofstream::trunc);
+    if(!fout)
+        throw std::runtime_error("failed to open quilt state file: " + filename);
+    write(fout);
+}
+
+QuiltState QuiltState::load(const std::string &filename)
+{
+    std::ifstream fin(filename, std::ifstream::in);
+    if(!fin)
+        throw std::runtime_error("failed to open quilt state file: " + filename);
+    return read(fin);
+}
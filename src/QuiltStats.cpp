@@ -0,0 +1,109 @@
+#include "../include/QuiltStats.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    double nsToMs(const std::atomic<uint64_t> &ns) noexcept
+    {
+        return static_cast<double>(ns.load()) / 1e6;
+    }
+
+    double averageBandSize(const QuiltStats &stats) noexcept
+    {
+        const uint64_t tiles = stats.tilesPlaced.load();
+        return tiles ?
+            static_cast<double>(stats.toleranceBandSum.load()) / tiles : 0.0;
+    }
+
+    bool endsWith(const std::string &str, const std::string &suffix)
+    {
+        return str.size() >= suffix.size() &&
+               str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+}
+
+void QuiltStats::reset() noexcept
+{
+    for(auto *counter : {
+        &totalNs, &scoringNs, &selectionNs, &seamNs, &placementNs,
+        &tilesPlaced, &candidatesEvaluated, &candidatesPruned, &coherentSelections,
+        &toleranceBandSum, &toleranceBandMax, &bytesAllocated,
+        &dtlbLoads, &dtlbLoadMisses })
+    {
+        counter->store(0, std::memory_order_relaxed);
+    }
+}
+
+void QuiltStats::writeJSON(std::ostream &out) const
+{
+    out << "{\n"
+        << "  \"enabled\": " << (QUILT_STATS_ENABLED ? "true" : "false") << ",\n"
+        << "  \"timings_ms\": {\n"
+        << "    \"total\": "     << nsToMs(totalNs)     << ",\n"
+        << "    \"scoring\": "   << nsToMs(scoringNs)   << ",\n"
+        << "    \"selection\": " << nsToMs(selectionNs) << ",\n"
+        << "    \"seam\": "      << nsToMs(seamNs)      << ",\n"
+        << "    \"placement\": " << nsToMs(placementNs) << "\n"
+        << "  },\n"
+        << "  \"counters\": {\n"
+        << "    \"tiles_placed\": "         << tilesPlaced         << ",\n"
+        << "    \"candidates_evaluated\": " << candidatesEvaluated << ",\n"
+        << "    \"candidates_pruned\": "    << candidatesPruned    << ",\n"
+        << "    \"coherent_selections\": "  << coherentSelections  << ",\n"
+        << "    \"tolerance_band_avg\": "   << averageBandSize(*this) << ",\n"
+        << "    \"tolerance_band_max\": "   << toleranceBandMax    << ",\n"
+        << "    \"bytes_allocated\": "      << bytesAllocated      << ",\n"
+        << "    \"dtlb_loads\": "           << dtlbLoads           << ",\n"
+        << "    \"dtlb_load_misses\": "     << dtlbLoadMisses      << "\n"
+        << "  }\n"
+        << "}\n";
+}
+
+void QuiltStats::writeCSV(std::ostream &out) const
+{
+    out << "name,value\n"
+        << "total_ms,"              << nsToMs(totalNs)     << "\n"
+        << "scoring_ms,"            << nsToMs(scoringNs)   << "\n"
+        << "selection_ms,"          << nsToMs(selectionNs) << "\n"
+        << "seam_ms,"               << nsToMs(seamNs)      << "\n"
+        << "placement_ms,"          << nsToMs(placementNs) << "\n"
+        << "tiles_placed,"          << tilesPlaced         << "\n"
+        << "candidates_evaluated,"  << candidatesEvaluated << "\n"
+        << "candidates_pruned,"     << candidatesPruned    << "\n"
+        << "coherent_selections,"   << coherentSelections  << "\n"
+        << "tolerance_band_avg,"    << averageBandSize(*this) << "\n"
+        << "tolerance_band_max,"    << toleranceBandMax    << "\n"
+        << "bytes_allocated,"       << bytesAllocated      << "\n"
+        << "dtlb_loads,"            << dtlbLoads           << "\n"
+        << "dtlb_load_misses,"      << dtlbLoadMisses      << "\n";
+}
+
+QuiltStats &quiltStats() noexcept
+{
+    static QuiltStats stats;
+    return stats;
+}
+
+void saveQuiltStats(const std::string &filename)
+{
+    std::ofstream fout(filename, std::ofstream::out | std::ofstream::trunc);
+    if(!fout)
+        throw std::runtime_error("failed to open stats file: " + filename);
+
+    if(endsWith(filename, ".csv") || endsWith(filename, ".CSV"))
+        quiltStats().writeCSV(fout);
+    else
+        quiltStats().writeJSON(fout);
+}
+
+void updateMaxStat(std::atomic<uint64_t> &counter, uint64_t value) noexcept
+{
+    uint64_t current = counter.load(std::memory_order_relaxed);
+    while(current < value && !counter.compare_exchange_weak(
+        current, value, std::memory_order_relaxed))
+    {
+
+    }
+}
@@ -1,8 +1,10 @@
 #include "../include/SeamCarving.h"
+#include "../include/QuiltStats.h"
 
+template<typename TextureA, typename TextureB>
 void computeVerticalSeamCost(
-    const Texture<Vec3>     &A,
-    const TextureView<Vec3> &B,
+    const TextureA &A,
+    const TextureB &B,
     int xA,    int yA,
     int xB,    int yB,
     int width, int height,
@@ -41,9 +43,10 @@ void computeVerticalSeamCost(
     }
 }
 
+template<typename TextureA, typename TextureB>
 void computeHorizontalSeamCost(
-    const Texture<Vec3>     &A,
-    const TextureView<Vec3> &B,
+    const TextureA &A,
+    const TextureB &B,
     int xA,    int yA,
     int xB,    int yB,
     int width, int height,
@@ -82,16 +85,23 @@ void computeHorizontalSeamCost(
     }
 }
 
+template<typename TextureA, typename TextureB>
 std::vector<int> findVerticalMinCostSeam(
-    const Texture<Vec3>     &A,
-    const TextureView<Vec3> &B,
+    const TextureA &A,
+    const TextureB &B,
     int xA,    int yA,
     int xB,    int yB,
     int width, int height)
 {
+    QUILT_STATS_TIMER(seam);
+
     thread_local static Texture<MinCostCutData> seamCosts;
     if(seamCosts.size() != agz::math::vec2i{ width - 1, height })
+    {
         seamCosts.initialize(height, width - 1);
+        QUILT_STATS_ADD(bytesAllocated,
+            sizeof(MinCostCutData) * (width - 1) * height);
+    }
 
     computeVerticalSeamCost(
         A, B, xA, yA, xB, yB, width, height, seamCosts);
@@ -120,16 +130,23 @@ std::vector<int> findVerticalMinCostSeam(
     return seam;
 }
 
+template<typename TextureA, typename TextureB>
 std::vector<int> findHorizontalMinCostSeam(
-    const Texture<Vec3>     &A,
-    const TextureView<Vec3> &B,
+    const TextureA &A,
+    const TextureB &B,
     int xA,    int yA,
     int xB,    int yB,
     int width, int height)
 {
+    QUILT_STATS_TIMER(seam);
+
     thread_local static Texture<MinCostCutData> seamCosts;
     if(seamCosts.size() != agz::math::vec2i{ width, height - 1 })
+    {
         seamCosts.initialize(height - 1, width);
+        QUILT_STATS_ADD(bytesAllocated,
+            sizeof(MinCostCutData) * width * (height - 1));
+    }
 
     computeHorizontalSeamCost(
         A, B, xA, yA, xB, yB, width, height, seamCosts);
@@ -157,3 +174,68 @@ std::vector<int> findHorizontalMinCostSeam(
 
     return seam;
 }
+
+template std::vector<int> findVerticalMinCostSeam(
+    const Texture<Vec3> &, const TextureView<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findHorizontalMinCostSeam(
+    const Texture<Vec3> &, const TextureView<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findVerticalMinCostSeam(
+    const BlockedTexture<Vec3> &, const BlockedTextureView<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findHorizontalMinCostSeam(
+    const BlockedTexture<Vec3> &, const BlockedTextureView<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findVerticalMinCostSeam(
+    const Texture<Vec3> &, const DihedralTileView<Texture<Vec3>> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findHorizontalMinCostSeam(
+    const Texture<Vec3> &, const DihedralTileView<Texture<Vec3>> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findVerticalMinCostSeam(
+    const BlockedTexture<Vec3> &, const DihedralTileView<BlockedTexture<Vec3>> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findHorizontalMinCostSeam(
+    const BlockedTexture<Vec3> &, const DihedralTileView<BlockedTexture<Vec3>> &,
+    int, int, int, int, int, int);
+
+// tile first, for seams towards content on the tile's right or bottom
+template std::vector<int> findVerticalMinCostSeam(
+    const TextureView<Vec3> &, const Texture<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findHorizontalMinCostSeam(
+    const TextureView<Vec3> &, const Texture<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findVerticalMinCostSeam(
+    const BlockedTextureView<Vec3> &, const BlockedTexture<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findHorizontalMinCostSeam(
+    const BlockedTextureView<Vec3> &, const BlockedTexture<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findVerticalMinCostSeam(
+    const DihedralTileView<Texture<Vec3>> &, const Texture<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findHorizontalMinCostSeam(
+    const DihedralTileView<Texture<Vec3>> &, const Texture<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findVerticalMinCostSeam(
+    const DihedralTileView<BlockedTexture<Vec3>> &, const BlockedTexture<Vec3> &,
+    int, int, int, int, int, int);
+
+template std::vector<int> findHorizontalMinCostSeam(
+    const DihedralTileView<BlockedTexture<Vec3>> &, const BlockedTexture<Vec3> &,
+    int, int, int, int, int, int);
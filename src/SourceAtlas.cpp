@@ -0,0 +1,156 @@
+#include "../include/SourceAtlas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+SourceAtlas::SourceAtlas(const std::vector<Texture<Vec3>> &sources)
+{
+    if(sources.empty())
+        throw std::runtime_error("source atlas needs at least one exemplar");
+
+    double area = 0;
+    int maxWidth = 0;
+    for(auto &source : sources)
+    {
+        area += static_cast<double>(source.width()) * source.height();
+        maxWidth = std::max(maxWidth, source.width());
+    }
+
+    const int atlasWidth = std::max(maxWidth, static_cast<int>(std::ceil(std::sqrt(area))));
+
+    std::vector<int> order(sources.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int lhs, int rhs)
+    {
+        return sources[lhs].height() > sources[rhs].height();
+    });
+
+    placements_.resize(sources.size());
+
+    int shelfX = 0, shelfY = 0, shelfHeight = 0;
+    for(int index : order)
+    {
+        const auto &source = sources[index];
+        if(shelfX + source.width() > atlasWidth)
+        {
+            shelfX = 0;
+            shelfY += shelfHeight;
+            shelfHeight = 0;
+        }
+
+        placements_[index] = { shelfX, shelfY, source.width(), source.height() };
+        shelfX += source.width();
+        shelfHeight = std::max(shelfHeight, source.height());
+    }
+
+    const int atlasHeight = shelfY + shelfHeight;
+    texture_ = Texture<Vec3>(atlasHeight, atlasWidth);
+
+    for(size_t i = 0; i < sources.size(); ++i)
+    {
+        const auto &source = sources[i];
+        const auto &placement = placements_[i];
+        for(int y = 0; y < source.height(); ++y)
+        {
+            for(int x = 0; x < source.width(); ++x)
+                texture_(placement.y + y, placement.x + x) = source(y, x);
+        }
+    }
+}
+
+CandidateIndex::CandidateIndex(
+    int  sourceWidth,
+    int  sourceHeight,
+    int  tileWidth,
+    int  tileHeight,
+    bool transforms)
+{
+    initializeTransforms(sourceWidth, sourceHeight, transforms);
+
+    for(size_t t = 0; t < transforms_.size(); ++t)
+    {
+        addRange(static_cast<int>(t) * slotWidth_, 0,
+                 transforms_[t].width() - tileWidth, transforms_[t].height() - tileHeight,
+                 static_cast<int>(t));
+    }
+}
+
+CandidateIndex::CandidateIndex(
+    const SourceAtlas &atlas,
+    int                tileWidth,
+    int                tileHeight,
+    bool               transforms)
+{
+    initializeTransforms(atlas.texture().width(), atlas.texture().height(), transforms);
+
+    for(size_t t = 0; t < transforms_.size(); ++t)
+    {
+        for(int i = 0; i < atlas.sourceCount(); ++i)
+        {
+            const auto &placement = atlas.placement(i);
+            if(placement.width <= tileWidth || placement.height <= tileHeight)
+            {
+                throw std::runtime_error(
+                    "exemplar " + std::to_string(i) + " is not larger than a tile");
+            }
+
+            // opposite corners of the exemplar in the transformed atlas
+            const auto a = transforms_[t].transformedPixel(placement.x, placement.y);
+            const auto b = transforms_[t].transformedPixel(
+                placement.x + placement.width - 1, placement.y + placement.height - 1);
+
+            const int x = std::min(a.x, b.x), y = std::min(a.y, b.y);
+            addRange(static_cast<int>(t) * slotWidth_ + x, y,
+                     std::abs(a.x - b.x) + 1 - tileWidth, std::abs(a.y - b.y) + 1 - tileHeight,
+                     static_cast<int>(t));
+        }
+    }
+}
+
+agz::math::vec2i CandidateIndex::operator[](long long index) const noexcept
+{
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), index,
+        [](long long i, const Range &range) { return i < range.firstIndex; });
+    const Range &range = *(it - 1);
+
+    const long long offset = index - range.firstIndex;
+    return { range.x + static_cast<int>(offset % range.width),
+             range.y + static_cast<int>(offset / range.width) };
+}
+
+int CandidateIndex::rangeOf(agz::math::vec2i xy) const noexcept
+{
+    for(size_t i = 0; i < ranges_.size(); ++i)
+    {
+        const Range &range = ranges_[i];
+        if(xy.x >= range.x && xy.x < range.x + range.width &&
+           xy.y >= range.y && xy.y < range.y + range.height)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+agz::math::vec2i CandidateIndex::clamp(agz::math::vec2i xy, int range) const noexcept
+{
+    const Range &r = ranges_[range];
+    return { std::clamp(xy.x, r.x, r.x + r.width - 1),
+             std::clamp(xy.y, r.y, r.y + r.height - 1) };
+}
+
+void CandidateIndex::initializeTransforms(int sourceWidth, int sourceHeight, bool transforms)
+{
+    const int count = transforms ? DihedralTransform::COUNT : 1;
+    for(int t = 0; t < count; ++t)
+        transforms_.emplace_back(t, sourceWidth, sourceHeight);
+
+    slotWidth_ = transforms ? std::max(sourceWidth, sourceHeight) : 0;
+}
+
+void CandidateIndex::addRange(int x, int y, int width, int height, int transform)
+{
+    ranges_.push_back({ x, y, width, height, size_, transform });
+    size_ += static_cast<long long>(width) * height;
+}
@@ -1,14 +1,97 @@
 #include "../include/TextureQuilter.h"
-#include <agz-utils/console.h>
-#include <map>
+#include "../include/QuiltStats.h"
+#include "../include/TileScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
 
+namespace
+{
+    // PatchMatch draws at most this many times randomInitCount random
+    // candidates while none scored above the duplicate threshold, e.g. on
+    // flat sources where every candidate is a near-duplicate
+    constexpr int PATCHMATCH_MAX_INIT_FACTOR = 16;
+
+    // grey texture of the luminance box-blurred with the given radius, so
+    // that its luminance is the blurred one
+    Texture<Vec3> blurredLuminance(const Texture<Vec3> &texture, int radius)
+    {
+        const int width = texture.width(), height = texture.height();
+
+        std::vector<float> lum(size_t(width) * height), horizontal(lum.size());
+        for(int y = 0; y < height; ++y)
+        {
+            for(int x = 0; x < width; ++x)
+                lum[y * width + x] = texture(y, x).lum();
+        }
+
+        for(int y = 0; y < height; ++y)
+        {
+            for(int x = 0; x < width; ++x)
+            {
+                float sum = 0;
+                for(int d = -radius; d <= radius; ++d)
+                    sum += lum[y * width + std::clamp(x + d, 0, width - 1)];
+                horizontal[y * width + x] = sum / (2 * radius + 1);
+            }
+        }
+
+        Texture<Vec3> result(height, width, agz::UNINIT);
+        for(int y = 0; y < height; ++y)
+        {
+            for(int x = 0; x < width; ++x)
+            {
+                float sum = 0;
+                for(int d = -radius; d <= radius; ++d)
+                    sum += horizontal[std::clamp(y + d, 0, height - 1) * width + x];
+                result(y, x) = Vec3(sum / (2 * radius + 1));
+            }
+        }
+        return result;
+    }
+
+    // uniformly random candidate position
+    agz::math::vec2i randomCandidate(
+        const CandidateIndex       &candidates,
+        std::default_random_engine &rng)
+    {
+        if(candidates.ranges().size() == 1)
+        {
+            const auto &range = candidates.ranges()[0];
+            std::uniform_int_distribution disX(range.x, range.x + range.width - 1);
+            std::uniform_int_distribution disY(range.y, range.y + range.height - 1);
+
+            const int srcX = disX(rng);
+            const int srcY = disY(rng);
+
+            return { srcX, srcY };
+        }
+
+        std::uniform_int_distribution<long long> disIndex(0, candidates.size() - 1);
+        return candidates[disIndex(rng)];
+    }
+}
 
 TextureQuilter::TextureQuilter()
     : tileWidth_(3), tileHeight_(3),
       seamWidth_(1), seamHeight_(1),
       tolerance_(0.1f),
       enableMSESelection_(true),
-      enableMinCut_(true)
+      enableMinCut_(true),
+      enableFastMetric_(false),
+      enableFixedPointMetric_(false),
+      enableBlockedStorage_(false),
+      enableTransforms_(false),
+      toroidal_(false),
+      coherenceCandidates_(0),
+      threadCount_(1),
+      enableNUMA_(false),
+      searchMode_(SearchMode::Exhaustive),
+      ttyProgress_(true)
 {
 
 }
@@ -47,172 +130,1950 @@ void TextureQuilter::enableMinCut(bool enable) noexcept
     enableMinCut_ = enable;
 }
 
+void TextureQuilter::enableFastMetric(bool enable) noexcept
+{
+    enableFastMetric_ = enable;
+}
+
+void TextureQuilter::enableFixedPointMetric(bool enable) noexcept
+{
+    enableFixedPointMetric_ = enable;
+}
+
+void TextureQuilter::enableBlockedStorage(bool enable) noexcept
+{
+    enableBlockedStorage_ = enable;
+}
+
+void TextureQuilter::enableTransformedCandidates(bool enable) noexcept
+{
+    enableTransforms_ = enable;
+}
+
+void TextureQuilter::enableToroidal(bool enable) noexcept
+{
+    toroidal_ = enable;
+}
+
+void TextureQuilter::enableCoherenceSearch(int cachedCandidates) noexcept
+{
+    coherenceCandidates_ = std::max(0, cachedCandidates);
+}
+
+void TextureQuilter::setSearchMode(SearchMode mode) noexcept
+{
+    searchMode_ = mode;
+}
+
+void TextureQuilter::setStochasticSearchParams(
+    const StochasticSearchParams &params) noexcept
+{
+    stochasticParams_ = params;
+}
+
+void TextureQuilter::setPatchMatchParams(const PatchMatchParams &params) noexcept
+{
+    patchMatchParams_ = params;
+}
+
+void TextureQuilter::setStridedSearchParams(
+    const StridedSearchParams &params) noexcept
+{
+    stridedParams_ = params;
+}
+
+void TextureQuilter::setThreadCount(int threadCount) noexcept
+{
+    threadCount_ = std::max(0, threadCount);
+}
+
+void TextureQuilter::enableNUMA(bool enable) noexcept
+{
+    enableNUMA_ = enable;
+}
+
+void TextureQuilter::setSeed(unsigned seed) noexcept
+{
+    seed_ = seed;
+}
+
+void TextureQuilter::setTraceFile(std::string filename)
+{
+    traceFile_ = std::move(filename);
+    traceRecorder_ = traceFile_.empty() ?
+        nullptr : std::make_shared<TraceRecorder>();
+}
+
+void TextureQuilter::setProgressReporter(
+    std::shared_ptr<ProgressReporter> reporter)
+{
+    progressReporter_ = std::move(reporter);
+    ttyProgress_      = false;
+}
+
+void TextureQuilter::setRowSink(RowSink sink)
+{
+    rowSink_ = std::move(sink);
+}
+
+std::pair<int, int> TextureQuilter::outputSize(int targetWidth, int targetHeight) const noexcept
+{
+    if(!toroidal_)
+        return { targetWidth, targetHeight };
+
+    // whole periods of at least two tile steps
+    const int stepX = tileWidth_ - seamWidth_;
+    const int stepY = tileHeight_ - seamHeight_;
+    return {
+        stepX * std::max(2, static_cast<int>(std::lround(static_cast<float>(targetWidth) / stepX))),
+        stepY * std::max(2, static_cast<int>(std::lround(static_cast<float>(targetHeight) / stepY)))
+    };
+}
+
 Texture<Vec3> TextureQuilter::quiltTexture(
     const Texture<Vec3> &source,
     int                  targetWidth,
-    int                  targetHeight) const
+    int                  targetHeight,
+    QuiltQuality        *quality,
+    QuiltState          *state,
+    QuiltMap            *map) const
 {
-    const int tileCountX = static_cast<int>(std::ceil(
-        static_cast<float>(targetWidth - seamWidth_)
-                        / (tileWidth_ - seamWidth_)));
-    const int tileCountY = static_cast<int>(std::ceil(
-        static_cast<float>(targetHeight - seamHeight_)
-                        / (tileHeight_ - seamHeight_)));
+    const unsigned seed = seed_ ? *seed_ : std::random_device()();
+    return synthesize(
+        source, nullptr, targetWidth, targetHeight, seed, nullptr, quality, state, map, nullptr);
+}
 
-    const int textureWidth = tileCountX * tileWidth_ - (tileCountX - 1) * seamWidth_;
-    const int textureHeight = tileCountY * tileHeight_ - (tileCountY - 1) * seamHeight_;
+Texture<Vec3> TextureQuilter::quiltTexture(
+    const SourceAtlas &sources,
+    int                targetWidth,
+    int                targetHeight,
+    QuiltQuality      *quality,
+    QuiltState        *state,
+    QuiltMap          *map) const
+{
+    const unsigned seed = seed_ ? *seed_ : std::random_device()();
+    return synthesize(
+        sources.texture(), &sources, targetWidth, targetHeight,
+        seed, nullptr, quality, state, map, nullptr);
+}
+
+Texture<Vec3> TextureQuilter::extendTexture(
+    const Texture<Vec3> &source,
+    const QuiltState    &previous,
+    int                  targetWidth,
+    int                  targetHeight,
+    QuiltQuality        *quality,
+    QuiltState          *state,
+    QuiltMap            *map) const
+{
+    validateExtension(previous, targetWidth, targetHeight);
+    return synthesize(
+        source, nullptr, targetWidth, targetHeight, previous.seed,
+        &previous, quality, state, map, nullptr);
+}
+
+Texture<Vec3> TextureQuilter::extendTexture(
+    const SourceAtlas &sources,
+    const QuiltState  &previous,
+    int                targetWidth,
+    int                targetHeight,
+    QuiltQuality      *quality,
+    QuiltState        *state,
+    QuiltMap          *map) const
+{
+    validateExtension(previous, targetWidth, targetHeight);
+    return synthesize(
+        sources.texture(), &sources, targetWidth, targetHeight, previous.seed,
+        &previous, quality, state, map, nullptr);
+}
 
-    Texture<Vec3> target(textureHeight, textureWidth);
+void TextureQuilter::validateExtension(
+    const QuiltState &previous,
+    int               targetWidth,
+    int               targetHeight) const
+{
+    if(previous.tileWidth != tileWidth_ || previous.tileHeight != tileHeight_ ||
+       previous.seamWidth != seamWidth_ || previous.seamHeight != seamHeight_)
+        throw std::runtime_error("quilt state was created with different tile parameters");
 
-    std::default_random_engine rng{ std::random_device()() };
+    if(targetWidth < previous.targetWidth || targetHeight < previous.targetHeight)
+        throw std::runtime_error("extended texture must not be smaller than the previous one");
 
-    agz::console::progress_bar_t pbar(tileCountY * tileCountX, 80, '=');
-    pbar.display();
+    if(static_cast<int>(previous.tiles.size()) != previous.tileCountX * previous.tileCountY)
+        throw std::runtime_error("invalid quilt state tile grid");
+}
 
-    for(int tileY = 0; tileY < tileCountY; ++tileY)
+Texture<Vec3> TextureQuilter::transferTexture(
+    const Texture<Vec3>  &source,
+    const Texture<Vec3>  &guide,
+    const TransferParams &params,
+    QuiltQuality         *quality) const
+{
+    if(params.passes < 1)
+        throw std::runtime_error("transfer needs at least one pass");
+
+    const unsigned seed = seed_ ? *seed_ : std::random_device()();
+
+    const SourceStatistics sourceStats(source);
+    const SourceStatistics blurredSourceStats(blurredLuminance(source, params.blurRadius));
+    const LuminancePlane guideLum(blurredLuminance(guide, params.blurRadius));
+
+    Texture<Vec3>  output;
+    LuminancePlane previousLum;
+
+    // the pass quilters share the recorder; their events are tagged with
+    // the pass and saved together
+    if(traceRecorder_)
+        traceRecorder_->clear();
+
+    for(int pass = 0; pass < params.passes; ++pass)
     {
-        const int y = tileY * (tileHeight_ - seamHeight_);
+        if(traceRecorder_)
+            traceRecorder_->setPass(pass);
 
-        for(int tileX = 0; tileX < tileCountX; ++tileX)
-        {
-            const int x = tileX * (tileWidth_ - seamWidth_);
+        const float shrink = std::pow(2.0f / 3, static_cast<float>(pass));
 
-            const auto tile = selectSourceTile(source, target, x, y, rng);
-            placeTile(tile, target, x, y);
+        TextureQuilter passQuilter = *this;
+        passQuilter.enableMSESelection_ = true;
+        passQuilter.enableTransforms_   = false;
+        passQuilter.toroidal_           = false;
+        // seam DPs need at least two overlap columns/rows to cut between
+        passQuilter.tileWidth_  = std::max(4, static_cast<int>(std::lround(tileWidth_ * shrink)));
+        passQuilter.tileHeight_ = std::max(4, static_cast<int>(std::lround(tileHeight_ * shrink)));
+        passQuilter.seamWidth_  = std::clamp(static_cast<int>(std::lround(seamWidth_ * shrink)),
+                                             std::min(2, seamWidth_), passQuilter.tileWidth_ / 2);
+        passQuilter.seamHeight_ = std::clamp(static_cast<int>(std::lround(seamHeight_ * shrink)),
+                                             std::min(2, seamHeight_), passQuilter.tileHeight_ / 2);
 
-            ++pbar;
+        const PlaneCorrelator blurredSourceCorrelator(
+            blurredSourceStats.luminance(), passQuilter.tileWidth_, passQuilter.tileHeight_);
+        std::optional<PlaneCorrelator> sourceCorrelator;
+        if(pass > 0)
+        {
+            sourceCorrelator.emplace(
+                sourceStats.luminance(), passQuilter.tileWidth_, passQuilter.tileHeight_);
         }
 
-        pbar.display();
+        TransferPass transfer;
+        transfer.alpha = params.passes == 1 ? params.alpha :
+            params.alpha + (0.9f - params.alpha) * pass / (params.passes - 1);
+        transfer.guideLum                = &guideLum;
+        transfer.previousLum             = pass > 0 ? &previousLum : nullptr;
+        transfer.blurredSource           = &blurredSourceStats;
+        transfer.blurredSourceCorrelator = &blurredSourceCorrelator;
+        transfer.source                  = &sourceStats;
+        transfer.sourceCorrelator        = sourceCorrelator ? &*sourceCorrelator : nullptr;
+
+        output = passQuilter.synthesize(
+            source, nullptr, guide.width(), guide.height(), seed,
+            nullptr, quality, nullptr, nullptr, &transfer);
+        previousLum = LuminancePlane(output);
     }
 
-    pbar.done();
+    if(traceRecorder_)
+        traceRecorder_->save(traceFile_);
 
-    return target.subtex(0, targetHeight, 0, targetWidth);
+    return output;
 }
 
-TextureView<Vec3> TextureQuilter::selectSourceTile(
-    const Texture<Vec3>         &source,
-    const Texture<Vec3>         &target,
-    int                          x,
-    int                          y,
-    std::default_random_engine  &rng) const
+void TextureQuilter::computeTransferError(
+    const TransferPass &transfer,
+    int                 x,
+    int                 y,
+    std::vector<float> &error) const
 {
-    if(!enableMSESelection_)
+    QUILT_STATS_TIMER(scoring);
+
+    const int tileArea = tileWidth_ * tileHeight_;
+    std::vector<float> pattern(tileArea), cross;
+
+    // tiles of the last row and column may reach past the guide's border
+    auto addTerm = [&](
+        const LuminancePlane   &targetLum,
+        const SourceStatistics &sourceStats,
+        const PlaneCorrelator  &correlator,
+        float                   weight)
     {
-        std::uniform_int_distribution disX(
-            0, static_cast<int>(source.width() - tileWidth_ - 1));
-        std::uniform_int_distribution disY(
-            0, static_cast<int>(source.height() - tileHeight_ - 1));
+        double patternSquaredSum = 0;
+        for(int yi = 0; yi < tileHeight_; ++yi)
+        {
+            const float *row = targetLum.row(std::min(y + yi, targetLum.height() - 1));
+            for(int xi = 0; xi < tileWidth_; ++xi)
+            {
+                const float lum = row[std::min(x + xi, targetLum.width() - 1)];
+                pattern[yi * tileWidth_ + xi] = lum;
+                patternSquaredSum += lum * lum;
+            }
+        }
+
+        correlator.correlate(pattern.data(), tileWidth_, cross);
+
+        const int resultWidth = correlator.resultWidth();
+        for(int srcY = 0; srcY < correlator.resultHeight(); ++srcY)
+        {
+            for(int srcX = 0; srcX < resultWidth; ++srcX)
+            {
+                const double squaredError =
+                    sourceStats.squaredSum(srcX, srcY, tileWidth_, tileHeight_)
+                  + patternSquaredSum - 2.0 * cross[srcY * resultWidth + srcX];
+                error[srcY * resultWidth + srcX] +=
+                    weight * static_cast<float>(std::max(0.0, squaredError) / tileArea);
+            }
+        }
+    };
+
+    const PlaneCorrelator &correlator = *transfer.blurredSourceCorrelator;
+    error.assign(size_t(correlator.resultWidth()) * correlator.resultHeight(), 0);
 
-        const int srcX = disX(rng);
-        const int srcY = disY(rng);
+    addTerm(*transfer.guideLum, *transfer.blurredSource,
+            correlator, 1 - transfer.alpha);
 
-        return source.subview(srcY, srcY + tileHeight_, srcX, srcX + tileWidth_);
+    if(transfer.previousLum)
+    {
+        addTerm(*transfer.previousLum, *transfer.source,
+                *transfer.sourceCorrelator, transfer.alpha);
     }
+}
 
-    std::multimap<float, agz::math::vec2i> mseToXY;
+Texture<Vec3> TextureQuilter::synthesize(
+    const Texture<Vec3> &source,
+    const SourceAtlas   *atlas,
+    int                  targetWidth,
+    int                  targetHeight,
+    unsigned             seed,
+    const QuiltState    *previous,
+    QuiltQuality        *quality,
+    QuiltState          *state,
+    QuiltMap            *map,
+    const TransferPass  *transfer) const
+{
+    QUILT_STATS_RESET();
+    QUILT_STATS_TIMER(total);
+    QUILT_STATS_TLB();
 
-    for(int srcY = 0; srcY < source.height() - tileHeight_; ++srcY)
+    if(toroidal_)
     {
-        for(int srcX = 0; srcX < source.width() - tileWidth_; ++srcX)
-        {
-            const float mse = calculateMSE(
-                source, target, srcX, srcY, x, y,
-                tileWidth_, tileHeight_, seamWidth_, seamHeight_);
+        if(previous || state || map)
+            throw std::runtime_error("toroidal quilting does not support quilt states and maps");
+
+        // the wrap-around overlaps of a tile must not reach its opposite side
+        if(tileWidth_ < 2 * seamWidth_ || tileHeight_ < 2 * seamHeight_)
+            throw std::runtime_error("toroidal quilting needs tiles at least twice as large as the seams");
+    }
 
-            if((x == 0 && y == 0) || mse > 0.001f)
-                mseToXY.insert({ mse, agz::math::vec2i{ srcX, srcY } });
+    // transferTexture traces all of its passes into one file
+    if(traceRecorder_ && !transfer)
+        traceRecorder_->clear();
+
+    const int stepX = tileWidth_ - seamWidth_;
+    const int stepY = tileHeight_ - seamHeight_;
+
+    // A toroidal grid of n tiles repeats every n steps. The target then holds
+    // one period plus the seam band past it, which overlaps the wrapped-around
+    // first column/row.
+    const auto [outputWidth, outputHeight] = outputSize(targetWidth, targetHeight);
+    const int tileCountX = toroidal_ ? outputWidth / stepX :
+        static_cast<int>(std::ceil(static_cast<float>(targetWidth - seamWidth_) / stepX));
+    const int tileCountY = toroidal_ ? outputHeight / stepY :
+        static_cast<int>(std::ceil(static_cast<float>(targetHeight - seamHeight_) / stepY));
+
+    const int textureWidth = tileCountX * tileWidth_ - (tileCountX - 1) * seamWidth_;
+    const int textureHeight = tileCountY * tileHeight_ - (tileCountY - 1) * seamHeight_;
+
+    const int threadCount = threadCount_ > 0 ? threadCount_ :
+        static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const bool parallel = threadCount > 1 &&
+        tileWidth_ >= 2 * seamWidth_ && tileHeight_ >= 2 * seamHeight_;
+
+    std::optional<NUMATopology> topology;
+    if(enableNUMA_ && parallel)
+        topology = NUMATopology::detect();
+
+    TileScheduler scheduler(
+        parallel ? threadCount : 1, topology ? &*topology : nullptr);
+
+    // Only the layout tiles are placed in is allocated; blocked storage is
+    // converted to a texture once at the end. The texture is allocated
+    // uninitialized so that the huge page advice precedes the first touch;
+    // with NUMA placement each node's first worker touches its band.
+    Texture<Vec3> target;
+    if(!enableBlockedStorage_)
+    {
+        target = Texture<Vec3>(textureHeight, textureWidth, agz::UNINIT);
+        adviseHugePages(target.raw_data(), sizeof(Vec3) * textureWidth * textureHeight);
+        if(!topology)
+        {
+            Vec3 *pixels = target.raw_data();
+            std::fill(pixels, pixels + static_cast<size_t>(textureWidth) * textureHeight, Vec3());
         }
+        QUILT_STATS_ADD(bytesAllocated, sizeof(Vec3) * textureWidth * textureHeight);
     }
 
-    const float maxAllowedMSE = mseToXY.begin()->first * (1 + tolerance_);
-    std::vector<agz::math::vec2i> allowedXYs;
+    std::vector<TileRecord> tiles(tileCountX * tileCountY);
 
-    for(auto &p : mseToXY)
+    const CandidateIndex candidates = atlas ?
+        CandidateIndex(*atlas, tileWidth_, tileHeight_, enableTransforms_) :
+        CandidateIndex(source.width(), source.height(), tileWidth_, tileHeight_, enableTransforms_);
+
+    QuiltContext sharedCtx;
+    sharedCtx.candidates = &candidates;
+    sharedCtx.target     = enableBlockedStorage_ ? nullptr : &target;
+    sharedCtx.tileCountX = tileCountX;
+    sharedCtx.tileCountY = tileCountY;
+    sharedCtx.tiles      = tiles.data();
+
+    if(toroidal_)
     {
-        if(p.first <= maxAllowedMSE)
-            allowedXYs.push_back(p.second);
-        else
-            break;
+        sharedCtx.periodWidth  = tileCountX * stepX;
+        sharedCtx.periodHeight = tileCountY * stepY;
     }
 
-    std::uniform_int_distribution dis(
-        0, static_cast<int>(allowedXYs.size() - 1));
-    const auto xy = allowedXYs[dis(rng)];
+    std::optional<TargetStatistics>         targetStats;
+    std::optional<FixedPointLuminancePlane> targetFixedPoint;
+    std::optional<BlockedTexture<Vec3>>     blockedTarget;
 
-    return source.subview(xy.y, xy.y + tileHeight_, xy.x, xy.x + tileWidth_);
-}
+    if(enableMSESelection_ && enableFixedPointMetric_)
+    {
+        targetFixedPoint.emplace();
+        targetFixedPoint->initialize(textureWidth, textureHeight);
+        sharedCtx.targetFixedPoint = &*targetFixedPoint;
+        QUILT_STATS_ADD(bytesAllocated, targetFixedPoint->byteSize());
+    }
+    else if(enableMSESelection_ && enableFastMetric_)
+    {
+        targetStats.emplace(textureWidth, textureHeight, stepX);
+        sharedCtx.targetStats = &*targetStats;
+        QUILT_STATS_ADD(bytesAllocated, targetStats->byteSize());
+    }
 
-void TextureQuilter::placeTile(
-    const TextureView<Vec3> &tile,
-    Texture<Vec3>           &target,
-    int                      x,
-    int                      y) const
-{
-    if(!enableMinCut_)
+    if(enableBlockedStorage_)
     {
-        for(int yi = 0; yi < tile.height(); ++yi)
+        blockedTarget.emplace(textureHeight, textureWidth);
+        sharedCtx.blockedTarget = &*blockedTarget;
+        QUILT_STATS_ADD(bytesAllocated, blockedTarget->byteSize());
+    }
+
+    std::vector<SourceReplica> replicas(scheduler.nodeCount());
+    if(topology)
+    {
+        scheduler.setWorkerInit([&](const TileScheduler::Worker &worker)
         {
-            for(int xi = 0; xi < tile.width(); ++xi)
+            if(worker.nodeRank != 0)
+                return;
+
+            initializeSourceReplica(replicas[worker.node], source, true);
+            if(blockedTarget)
+                return;
+
+            // pixel rows of the node's band of tile rows
+            int bandBegin = textureHeight, bandEnd = 0;
+            for(int tileY = 0; tileY < tileCountY; ++tileY)
             {
-                target(y + yi, x + xi) = tile(yi, xi);
+                if(scheduler.nodeOfRow(tileY, tileCountY) != worker.node)
+                    continue;
+
+                bandBegin = std::min(bandBegin, tileY * stepY);
+                bandEnd   = tileY + 1 == tileCountY ? textureHeight : (tileY + 1) * stepY;
             }
-        }
-        return;
+
+            for(int y = bandBegin; y < bandEnd; ++y)
+            {
+                for(int x = 0; x < textureWidth; ++x)
+                    target(y, x) = Vec3();
+            }
+        });
     }
+    else
+        initializeSourceReplica(replicas[0], source, false);
 
-    if(x > 0 && y == 0)
+    // Tiles of previous are replayed from their records unless the search
+    // would see different pixels than when they were chosen, i.e. when a tile
+    // placed before them and overlapping them is new or searched again. With
+    // new columns this starts at the last previous column, whose top-right
+    // neighbours are new.
+    std::vector<char> searchTile(tileCountX * tileCountY, 1);
+    if(previous)
     {
-        const auto verticalSeam = findVerticalMinCostSeam(
-            target, tile, x, y, 0, 0, seamWidth_, tileHeight_);
-
-        for(int yi = 0; yi < tile.height(); ++yi)
+        for(int tileY = 0; tileY < std::min(tileCountY, previous->tileCountY); ++tileY)
         {
-            for(int xi = 0; xi < tile.width(); ++xi)
+            for(int tileX = 0; tileX < std::min(tileCountX, previous->tileCountX); ++tileX)
             {
-                if(xi > verticalSeam[yi])
-                    target(y + yi, x + xi) = tile(yi, xi);
+                const auto searched = [&](int dx, int dy)
+                {
+                    const int nx = tileX + dx, ny = tileY + dy;
+                    return nx >= 0 && ny >= 0 && nx < tileCountX &&
+                           searchTile[ny * tileCountX + nx];
+                };
+
+                searchTile[tileY * tileCountX + tileX] =
+                    searched(-1, 0) || searched(-1, -1) ||
+                    searched(0, -1) || searched(1, -1);
             }
         }
     }
-    else if(x == 0 && y > 0)
+
+    TTYProgressReporter ttyReporter;
+    ProgressMonitor progress(
+        ttyProgress_ ? &ttyReporter : progressReporter_.get(), tileCountY * tileCountX);
+
+    // Output rows above the next tile row are final once all tile rows up to
+    // it are complete; the toroidal output starts past the first seam bands.
+    const bool streamRows = rowSink_ && !transfer;
+    const int rowOffset    = toroidal_ ? seamHeight_ : 0;
+    const int columnOffset = toroidal_ ? seamWidth_  : 0;
+
+    std::mutex         rowMutex;
+    std::vector<int>   placedTiles(tileCountY, 0);
+    std::vector<Vec3>  rowBuffer;
+    int completeTileRows = 0;
+    int emittedRows      = 0;
+
+    auto emitCompleteRows = [&](int tileY)
     {
-        const auto horizontalSeam = findHorizontalMinCostSeam(
-            target, tile, x, y, 0, 0, tileWidth_, seamHeight_);
+        std::lock_guard lock(rowMutex);
 
-        for(int yi = 0; yi < tile.height(); ++yi)
+        if(++placedTiles[tileY] < tileCountX)
+            return;
+        while(completeTileRows < tileCountY && placedTiles[completeTileRows] == tileCountX)
+            ++completeTileRows;
+
+        const int finalRows = completeTileRows == tileCountY ? outputHeight :
+            std::min(outputHeight, completeTileRows * stepY - rowOffset);
+
+        for(; emittedRows < finalRows; ++emittedRows)
         {
-            for(int xi = 0; xi < tile.width(); ++xi)
+            const int y = emittedRows + rowOffset;
+            if(blockedTarget)
             {
-                if(yi > horizontalSeam[xi])
-                    target(y + yi, x + xi) = tile(yi, xi);
+                rowBuffer.resize(outputWidth);
+                for(int x = 0; x < outputWidth; ++x)
+                    rowBuffer[x] = (*blockedTarget)(y, x + columnOffset);
+                rowSink_(emittedRows, rowBuffer.data(), outputWidth);
             }
+            else
+                rowSink_(emittedRows, &target(y, columnOffset), outputWidth);
+        }
+    };
+
+    scheduler.run(tileCountX, tileCountY,
+        [&](int tileX, int tileY, const TileScheduler::Worker &worker)
+    {
+        QuiltContext ctx = sharedCtx;
+        ctx.useSource(replicas[worker.node]);
+
+        std::seed_seq seedSeq{
+            seed, static_cast<unsigned>(tileX), static_cast<unsigned>(tileY) };
+        std::default_random_engine rng(seedSeq);
+
+        const int x = tileX * stepX;
+        const int y = tileY * stepY;
+
+        if(toroidal_ && tileX == tileCountX - 1 && tileY > 0)
+            mergeWrapBand(ctx, tileY);
+
+        std::vector<float> transferError;
+        if(transfer && searchTile[tileY * tileCountX + tileX])
+        {
+            computeTransferError(*transfer, x, y, transferError);
+            ctx.transferError  = transferError.data();
+            ctx.transferStride = source.width() - tileWidth_ + 1;
+            ctx.overlapWeight  = transfer->alpha;
+        }
+
+        if(!searchTile[tileY * tileCountX + tileX])
+            ctx.tile(tileX, tileY) = previous->tile(tileX, tileY);
+        else
+        {
+            ScopedTraceEvent traceSelect(
+                traceRecorder_.get(), "select", x, y);
+            if(ctx.targetStats)
+                computeTargetOverlapSums(ctx, x, y);
+            selectSourceTile(ctx, tileX, tileY, rng);
+        }
+
+        {
+            ScopedTraceEvent tracePlace(
+                traceRecorder_.get(), "place", x, y);
+            placeSelectedTile(ctx, ctx.tile(tileX, tileY), x, y);
+
+            if(toroidal_)
+                copyWrapBands(ctx, tileX, tileY);
+        }
+
+        if(streamRows)
+            emitCompleteRows(tileY);
+
+        QUILT_STATS_ADD(tilesPlaced, 1);
+        progress.advance();
+    }, toroidal_);
+
+    if(traceRecorder_ && !transfer)
+        traceRecorder_->save(traceFile_);
+
+    if(quality)
+    {
+        *quality = QuiltQuality();
+
+        double bestMSESum = 0;
+        for(auto &record : tiles)
+        {
+            bestMSESum += record.bestMSE;
+            quality->worstBestMSE = std::max(quality->worstBestMSE, record.bestMSE);
+            quality->evaluatedCandidates += record.evaluatedCandidates;
         }
+        quality->meanBestMSE = static_cast<float>(bestMSESum / tiles.size());
     }
-    else if(x > 0 && y > 0)
+
+    if(map)
     {
-        const auto verticalSeam = findVerticalMinCostSeam(
-            target, tile, x, y, 0, 0, seamWidth_, tileHeight_);
+        map->tileWidth    = tileWidth_;
+        map->tileHeight   = tileHeight_;
+        map->seamWidth    = seamWidth_;
+        map->seamHeight   = seamHeight_;
+        map->targetWidth  = targetWidth;
+        map->targetHeight = targetHeight;
+        map->sourceWidth  = source.width();
+        map->sourceHeight = source.height();
+        map->tileCountX   = tileCountX;
+        map->tileCountY   = tileCountY;
+        map->slotWidth    = candidates.slotWidth();
 
-        const auto horizontalSeam = findHorizontalMinCostSeam(
-            target, tile, x, y, 0, 0, tileWidth_, seamHeight_);
+        map->sources.resize(tiles.size());
+        map->leftSeams.assign(tiles.size() * tileHeight_, 0);
+        map->topSeams.assign(tiles.size() * tileWidth_, 0);
 
-        for(int yi = 0; yi < tile.height(); ++yi)
+        for(size_t i = 0; i < tiles.size(); ++i)
         {
-            for(int xi = 0; xi < tile.width(); ++xi)
-            {
-                if(xi > verticalSeam[yi] && yi > horizontalSeam[xi])
-                    target(y + yi, x + xi) = tile(yi, xi);
-            }
+            map->sources[i] = tiles[i].source;
+            for(size_t yi = 0; yi < tiles[i].leftSeam.size(); ++yi)
+                map->leftSeams[i * tileHeight_ + yi] = static_cast<uint16_t>(tiles[i].leftSeam[yi] + 1);
+            for(size_t xi = 0; xi < tiles[i].topSeam.size(); ++xi)
+                map->topSeams[i * tileWidth_ + xi] = static_cast<uint16_t>(tiles[i].topSeam[xi] + 1);
         }
     }
-    else
+
+    if(state)
     {
-        for(int yi = 0; yi < tile.height(); ++yi)
+        state->tileWidth    = tileWidth_;
+        state->tileHeight   = tileHeight_;
+        state->seamWidth    = seamWidth_;
+        state->seamHeight   = seamHeight_;
+        state->seed         = seed;
+        state->targetWidth  = targetWidth;
+        state->targetHeight = targetHeight;
+        state->tileCountX   = tileCountX;
+        state->tileCountY   = tileCountY;
+        state->tiles        = std::move(tiles);
+    }
+
+    if(blockedTarget)
+        target = blockedTarget->toTexture();
+
+    // the bands past the period hold the final wrap-around overlaps, the ones
+    // at the start only what the first column/row placed
+    return target.subtex(
+        rowOffset, rowOffset + outputHeight, columnOffset, columnOffset + outputWidth);
+}
+
+void TextureQuilter::copyWrapBands(
+    QuiltContext &ctx,
+    int           tileX,
+    int           tileY) const
+{
+    const int x = tileX * (tileWidth_ - seamWidth_);
+    const int y = tileY * (tileHeight_ - seamHeight_);
+
+    // the top band of later rows is cut again by the tile below, see
+    // mergeWrapBand
+    if(tileX == 0)
+    {
+        const int top = tileY > 0 ? seamHeight_ : 0;
+        copyTargetRegion(
+            ctx, 0, y + top, ctx.periodWidth, y + top, seamWidth_, tileHeight_ - top);
+    }
+
+    // the next tile of the row copies its left band again after cutting it
+    if(tileY == 0)
+        copyTargetRegion(ctx, x, 0, x, ctx.periodHeight, tileWidth_, seamHeight_);
+
+    if(tileY == 0 && tileX == ctx.tileCountX - 1)
+    {
+        copyTargetRegion(
+            ctx, ctx.periodWidth, 0, 0, ctx.periodHeight, seamWidth_, seamHeight_);
+    }
+}
+
+void TextureQuilter::mergeWrapBand(
+    QuiltContext &ctx,
+    int           tileY) const
+{
+    const std::vector<int> &topSeam = ctx.tile(0, tileY).topSeam;
+    const int y = tileY * (tileHeight_ - seamHeight_);
+
+    for(int xi = 0; xi < seamWidth_; ++xi)
+    {
+        const int top = topSeam.empty() ? 0 : topSeam[xi] + 1;
+        copyTargetRegion(
+            ctx, xi, y + top, ctx.periodWidth + xi, y + top, 1, seamHeight_ - top);
+    }
+}
+
+void TextureQuilter::copyTargetRegion(
+    QuiltContext &ctx,
+    int           fromX,
+    int           fromY,
+    int           toX,
+    int           toY,
+    int           width,
+    int           height) const
+{
+    if(width <= 0 || height <= 0)
+        return;
+
+    auto copy = [&](auto &target)
+    {
+        for(int yi = 0; yi < height; ++yi)
         {
-            for(int xi = 0; xi < tile.width(); ++xi)
-                target(y + yi, x + xi) = tile(yi, xi);
+            for(int xi = 0; xi < width; ++xi)
+                target(toY + yi, toX + xi) = target(fromY + yi, fromX + xi);
+        }
+
+        if(ctx.targetStats)
+            ctx.targetStats->update(target, toX, toY, width, height);
+
+        if(ctx.targetFixedPoint)
+            ctx.targetFixedPoint->update(target, toX, toY, width, height);
+    };
+
+    if(ctx.blockedTarget)
+        copy(*ctx.blockedTarget);
+    else
+        copy(*ctx.target);
+}
+
+Texture<Vec3> TextureQuilter::quiltMaskedRegion(
+    const Texture<Vec3>  &source,
+    const Texture<Vec3>  &target,
+    const Texture<float> &mask) const
+{
+    if(mask.width() != target.width() || mask.height() != target.height())
+        throw std::runtime_error("mask and target sizes differ");
+    if(target.width() < tileWidth_ || target.height() < tileHeight_)
+        throw std::runtime_error("target is smaller than one tile");
+    if(source.width() < tileWidth_ || source.height() < tileHeight_)
+        throw std::runtime_error("source is smaller than one tile");
+
+    QUILT_STATS_RESET();
+    QUILT_STATS_TIMER(total);
+
+    if(traceRecorder_)
+        traceRecorder_->clear();
+
+    const int stepX = tileWidth_ - seamWidth_;
+    const int stepY = tileHeight_ - seamHeight_;
+
+    const int tileCountX = std::max(1, static_cast<int>(std::ceil(
+        static_cast<float>(target.width() - seamWidth_) / stepX)));
+    const int tileCountY = std::max(1, static_cast<int>(std::ceil(
+        static_cast<float>(target.height() - seamHeight_) / stepY)));
+
+    // the last column and row of tiles are shifted back inside the target
+    auto tileXToX = [&](int tileX) { return std::min(tileX * stepX, target.width() - tileWidth_); };
+    auto tileYToY = [&](int tileY) { return std::min(tileY * stepY, target.height() - tileHeight_); };
+
+    std::vector<char> requilt(tileCountX * tileCountY, 0);
+    int requiltCount = 0;
+
+    for(int tileY = 0; tileY < tileCountY; ++tileY)
+    {
+        for(int tileX = 0; tileX < tileCountX; ++tileX)
+        {
+            const int x = tileXToX(tileX), y = tileYToY(tileY);
+
+            bool masked = false;
+            for(int yi = y; yi < y + tileHeight_ && !masked; ++yi)
+            {
+                for(int xi = x; xi < x + tileWidth_ && !masked; ++xi)
+                    masked = mask(yi, xi) > 0.5f;
+            }
+
+            requilt[tileY * tileCountX + tileX] = masked;
+            requiltCount += masked;
+        }
+    }
+
+    Texture<Vec3> result = target;
+    QUILT_STATS_ADD(bytesAllocated, sizeof(Vec3) * target.width() * target.height());
+
+    if(!requiltCount)
+        return result;
+
+    const LuminancePlane sourceLum(source);
+    QUILT_STATS_ADD(bytesAllocated, sourceLum.byteSize());
+
+    const unsigned seed = seed_ ? *seed_ : std::random_device()();
+
+    TTYProgressReporter ttyReporter;
+    ProgressMonitor progress(
+        ttyProgress_ ? &ttyReporter : progressReporter_.get(), requiltCount);
+
+    // raster order: left and top neighbours are final when a tile is placed,
+    // right and bottom ones only when they are kept
+    for(int tileY = 0; tileY < tileCountY; ++tileY)
+    {
+        for(int tileX = 0; tileX < tileCountX; ++tileX)
+        {
+            if(!requilt[tileY * tileCountX + tileX])
+                continue;
+
+            const int x = tileXToX(tileX), y = tileYToY(tileY);
+
+            ConstrainedTile constrained;
+            constrained.x      = x;
+            constrained.y      = y;
+            constrained.left   = tileX > 0;
+            constrained.top    = tileY > 0;
+            constrained.right  = tileX + 1 < tileCountX && !requilt[tileY * tileCountX + tileX + 1];
+            constrained.bottom = tileY + 1 < tileCountY && !requilt[(tileY + 1) * tileCountX + tileX];
+
+            for(int yi = 0; yi < tileHeight_; ++yi)
+            {
+                for(int xi = 0; xi < tileWidth_; ++xi)
+                {
+                    if(mask(y + yi, x + xi) > 0.5f)
+                    {
+                        constrained.maskedLum.push_back(
+                            { yi * tileWidth_ + xi, target(y + yi, x + xi).lum() });
+                    }
+                }
+            }
+
+            std::seed_seq seedSeq{
+                seed, static_cast<unsigned>(tileX), static_cast<unsigned>(tileY) };
+            std::default_random_engine rng(seedSeq);
+
+            const auto xy = [&]
+            {
+                ScopedTraceEvent traceSelect(
+                    traceRecorder_.get(), "select", x, y);
+                return selectConstrainedSourceTile(
+                    source, sourceLum, result, constrained, rng);
+            }();
+
+            {
+                ScopedTraceEvent tracePlace(
+                    traceRecorder_.get(), "place", x, y);
+                placeConstrainedTile(source, result, xy, constrained);
+            }
+
+            QUILT_STATS_ADD(tilesPlaced, 1);
+            progress.advance();
+        }
+    }
+
+    if(traceRecorder_)
+        traceRecorder_->save(traceFile_);
+
+    return result;
+}
+
+void TextureQuilter::initializeSourceReplica(
+    SourceReplica       &replica,
+    const Texture<Vec3> &source,
+    bool                 copy) const
+{
+    if(copy)
+    {
+        replica.copy = Texture<Vec3>(source.height(), source.width(), agz::UNINIT);
+        adviseHugePages(
+            replica.copy.raw_data(), sizeof(Vec3) * source.width() * source.height());
+
+        for(int y = 0; y < source.height(); ++y)
+        {
+            for(int x = 0; x < source.width(); ++x)
+                replica.copy(y, x) = source(y, x);
+        }
+        replica.texture = &replica.copy;
+        QUILT_STATS_ADD(bytesAllocated,
+            sizeof(Vec3) * source.width() * source.height());
+    }
+    else
+        replica.texture = &source;
+
+    if(enableMSESelection_ && enableFixedPointMetric_)
+    {
+        replica.fixedPoint.emplace(*replica.texture);
+        QUILT_STATS_ADD(bytesAllocated, replica.fixedPoint->byteSize());
+    }
+    else if(enableMSESelection_ && enableFastMetric_)
+    {
+        replica.stats.emplace(*replica.texture);
+        QUILT_STATS_ADD(bytesAllocated, replica.stats->byteSize());
+    }
+
+    if(enableBlockedStorage_)
+    {
+        replica.blocked.emplace(*replica.texture);
+        QUILT_STATS_ADD(bytesAllocated, replica.blocked->byteSize());
+    }
+
+    // transformed candidates read the statistics' luminance when there is one
+    if(enableTransforms_ && enableMSESelection_ && !replica.fixedPoint && !replica.stats)
+    {
+        replica.luminance.emplace(*replica.texture);
+        QUILT_STATS_ADD(bytesAllocated, replica.luminance->byteSize());
+    }
+}
+
+float TextureQuilter::scoreCandidate(
+    const QuiltContext &ctx,
+    int                 srcX,
+    int                 srcY,
+    int                 x,
+    int                 y) const
+{
+    float overlapError = scoreOverlap(ctx, srcX, srcY, x, y);
+    if(ctx.wrapsRight(x, tileWidth_) || ctx.wrapsBottom(y, tileHeight_))
+        overlapError = scoreWrappedOverlap(ctx, overlapError, srcX, srcY, x, y);
+    return blendTransferError(ctx, overlapError, srcX, srcY);
+}
+
+float TextureQuilter::scoreWrappedOverlap(
+    const QuiltContext &ctx,
+    float               overlapError,
+    int                 srcX,
+    int                 srcY,
+    int                 x,
+    int                 y) const
+{
+    const CandidateIndex::Candidate candidate = ctx.candidates->resolve({ srcX, srcY });
+
+    const int leftW   = x > 0 ? seamWidth_ : 0;
+    const int topH    = y > 0 ? seamHeight_ : 0;
+    const int rightW  = ctx.wrapsRight(x, tileWidth_) ? seamWidth_ : 0;
+    const int bottomH = ctx.wrapsBottom(y, tileHeight_) ? seamHeight_ : 0;
+
+    // right strip below the top one, then the rest of the bottom strip
+    const int rightH  = tileHeight_ - topH;
+    const int bottomW = tileWidth_ - leftW - rightW;
+
+    const int overlapCount = leftW * tileHeight_ + (tileWidth_ - leftW) * topH;
+    const int pixelCount = overlapCount + rightW * rightH + bottomW * bottomH;
+
+    const double squaredErrorSum =
+        static_cast<double>(overlapError) * overlapCount
+      + scoreOverlapRegion(ctx, candidate, tileWidth_ - rightW, topH, rightW, rightH, x, y,
+                           ctx.targetRightSum)
+      + scoreOverlapRegion(ctx, candidate, leftW, tileHeight_ - bottomH, bottomW, bottomH, x, y,
+                           ctx.targetBottomSum);
+
+    return static_cast<float>(squaredErrorSum / pixelCount);
+}
+
+void TextureQuilter::computeTargetOverlapSums(
+    QuiltContext &ctx,
+    int           x,
+    int           y) const
+{
+    ctx.targetOverlap = calculateTargetOverlapSums(
+        *ctx.targetStats, x, y, tileWidth_, tileHeight_, seamWidth_, seamHeight_);
+
+    // the strips of scoreWrappedOverlap
+    const int leftW   = x > 0 ? seamWidth_ : 0;
+    const int topH    = y > 0 ? seamHeight_ : 0;
+    const int rightW  = ctx.wrapsRight(x, tileWidth_) ? seamWidth_ : 0;
+    const int bottomH = ctx.wrapsBottom(y, tileHeight_) ? seamHeight_ : 0;
+    const int rightH  = tileHeight_ - topH;
+    const int bottomW = tileWidth_ - leftW - rightW;
+
+    ctx.targetRightSum = rightW > 0 && rightH > 0 ?
+        ctx.targetStats->squaredSum(x + tileWidth_ - rightW, y + topH, rightW, rightH) : 0;
+    ctx.targetBottomSum = bottomW > 0 && bottomH > 0 ?
+        ctx.targetStats->squaredSum(x + leftW, y + tileHeight_ - bottomH, bottomW, bottomH) : 0;
+}
+
+float TextureQuilter::scoreOverlapRegion(
+    const QuiltContext              &ctx,
+    const CandidateIndex::Candidate &candidate,
+    int                              offsetX,
+    int                              offsetY,
+    int                              width,
+    int                              height,
+    int                              x,
+    int                              y,
+    double                           targetSum) const
+{
+    if(width <= 0 || height <= 0)
+        return 0;
+
+    const DihedralTransform &transform = *candidate.transform;
+    const int u  = candidate.position.x + offsetX, v  = candidate.position.y + offsetY;
+    const int tx = x + offsetX,                    ty = y + offsetY;
+
+    if(ctx.sourceFixedPoint)
+    {
+        const int64_t sum = transform.isIdentity() ?
+            calculateErrorSum(*ctx.sourceFixedPoint, u, v, *ctx.targetFixedPoint, tx, ty, width, height) :
+            calculateErrorSum(*ctx.sourceFixedPoint, transform, u, v,
+                              *ctx.targetFixedPoint, tx, ty, width, height);
+
+        constexpr double scale2 = static_cast<double>(LUMINANCE_FIXED_POINT_SCALE)
+                                * LUMINANCE_FIXED_POINT_SCALE;
+        return static_cast<float>(sum / scale2);
+    }
+
+    if(!transform.isIdentity())
+    {
+        if(ctx.targetStats)
+        {
+            return calculateErrorSum(
+                *ctx.sourceLuminance, transform, u, v, *ctx.targetStats, tx, ty, width, height);
+        }
+
+        if(ctx.blockedTarget)
+        {
+            return calculateErrorSum(
+                *ctx.sourceLuminance, transform, u, v, *ctx.blockedTarget, tx, ty, width, height);
+        }
+
+        return calculateErrorSum(
+            *ctx.sourceLuminance, transform, u, v, *ctx.target, tx, ty, width, height);
+    }
+
+    if(ctx.sourceStats)
+    {
+        return calculateErrorSum(
+            *ctx.sourceStats, u, v, *ctx.targetStats, tx, ty, width, height, targetSum);
+    }
+
+    if(ctx.blockedSource)
+        return calculateErrorSum(*ctx.blockedSource, u, v, *ctx.blockedTarget, tx, ty, width, height);
+
+    return calculateErrorSum(*ctx.source, u, v, *ctx.target, tx, ty, width, height);
+}
+
+float TextureQuilter::scoreOverlap(
+    const QuiltContext &ctx,
+    int                 srcX,
+    int                 srcY,
+    int                 x,
+    int                 y) const
+{
+    const CandidateIndex::Candidate candidate = ctx.candidates->resolve({ srcX, srcY });
+    if(!candidate.transform->isIdentity())
+        return scoreTransformedOverlap(ctx, candidate, x, y);
+
+    if(ctx.sourceFixedPoint)
+    {
+        return calculateMSE(
+            *ctx.sourceFixedPoint, *ctx.targetFixedPoint, srcX, srcY, x, y,
+            tileWidth_, tileHeight_, seamWidth_, seamHeight_);
+    }
+
+    if(ctx.sourceStats)
+    {
+        return calculateMSE(
+            *ctx.sourceStats, *ctx.targetStats, srcX, srcY, x, y,
+            tileWidth_, tileHeight_, seamWidth_, seamHeight_, ctx.targetOverlap);
+    }
+
+    if(ctx.blockedSource)
+    {
+        return calculateMSE(
+            *ctx.blockedSource, *ctx.blockedTarget, srcX, srcY, x, y,
+            tileWidth_, tileHeight_, seamWidth_, seamHeight_);
+    }
+
+    return calculateMSE(
+        *ctx.source, *ctx.target, srcX, srcY, x, y,
+        tileWidth_, tileHeight_, seamWidth_, seamHeight_);
+}
+
+float TextureQuilter::scoreTransformedOverlap(
+    const QuiltContext              &ctx,
+    const CandidateIndex::Candidate &candidate,
+    int                              x,
+    int                              y) const
+{
+    const DihedralTransform &transform = *candidate.transform;
+    const int srcX = candidate.position.x, srcY = candidate.position.y;
+
+    if(ctx.sourceFixedPoint)
+    {
+        return calculateMSE(
+            *ctx.sourceFixedPoint, transform, *ctx.targetFixedPoint, srcX, srcY, x, y,
+            tileWidth_, tileHeight_, seamWidth_, seamHeight_);
+    }
+
+    if(ctx.targetStats)
+    {
+        return calculateMSE(
+            *ctx.sourceLuminance, transform, *ctx.targetStats, srcX, srcY, x, y,
+            tileWidth_, tileHeight_, seamWidth_, seamHeight_);
+    }
+
+    if(ctx.blockedTarget)
+    {
+        return calculateMSE(
+            *ctx.sourceLuminance, transform, *ctx.blockedTarget, srcX, srcY, x, y,
+            tileWidth_, tileHeight_, seamWidth_, seamHeight_);
+    }
+
+    return calculateMSE(
+        *ctx.sourceLuminance, transform, *ctx.target, srcX, srcY, x, y,
+        tileWidth_, tileHeight_, seamWidth_, seamHeight_);
+}
+
+void TextureQuilter::addCandidate(
+    CandidateMap     &mseToXY,
+    float             mse,
+    agz::math::vec2i  xy,
+    int               x,
+    int               y) const
+{
+    if((x == 0 && y == 0) || mse > 0.001f)
+        mseToXY.insert({ mse, xy });
+}
+
+int TextureQuilter::scanAllCandidates(
+    const QuiltContext &ctx,
+    int                 x,
+    int                 y,
+    CandidateMap       &mseToXY) const
+{
+    QUILT_STATS_TIMER(scoring);
+
+    for(auto &range : ctx.candidates->ranges())
+    {
+        const int endX = range.x + range.width;
+
+        for(int srcY = range.y; srcY < range.y + range.height; ++srcY)
+        {
+            int srcX = range.x;
+
+            // the batch kernel scores MSE_BATCH_SIZE adjacent candidates and
+            // reads MSE_BATCH_SIZE - 1 texels past its first one, so the last
+            // fewer than MSE_BATCH_SIZE candidates of each row take the scalar
+            // path; transformed candidates are not adjacent in the source, and the
+            // kernel only scores the left and top strips
+            if(ctx.sourceStats && range.transform == 0 &&
+               !ctx.wrapsRight(x, tileWidth_) && !ctx.wrapsBottom(y, tileHeight_))
+            {
+                for(; srcX + MSE_BATCH_SIZE <= endX; srcX += MSE_BATCH_SIZE)
+                {
+                    float mses[MSE_BATCH_SIZE];
+                    calculateMSEBatch(
+                        *ctx.sourceStats, *ctx.targetStats, srcX, srcY, x, y,
+                        tileWidth_, tileHeight_, seamWidth_, seamHeight_,
+                        ctx.targetOverlap, mses);
+
+                    for(int k = 0; k < MSE_BATCH_SIZE; ++k)
+                    {
+                        addCandidate(mseToXY, blendTransferError(ctx, mses[k], srcX + k, srcY),
+                                     { srcX + k, srcY }, x, y);
+                    }
+                }
+            }
+
+            for(; srcX < endX; ++srcX)
+            {
+                const float mse = scoreCandidate(ctx, srcX, srcY, x, y);
+                addCandidate(mseToXY, mse, { srcX, srcY }, x, y);
+            }
+        }
+    }
+
+    return static_cast<int>(ctx.candidates->size());
+}
+
+int TextureQuilter::scanStochasticCandidates(
+    const QuiltContext         &ctx,
+    int                         x,
+    int                         y,
+    std::default_random_engine &rng,
+    CandidateMap               &mseToXY) const
+{
+    QUILT_STATS_TIMER(scoring);
+
+    const CandidateIndex &candidates = *ctx.candidates;
+    const long long positionCount = candidates.size();
+
+    const auto &params = stochasticParams_;
+    const long long sampleCount = std::clamp<long long>(
+        params.sampleCount > 0 ? params.sampleCount : static_cast<long long>(
+            std::ceil(params.sampleFraction * positionCount)),
+        1, positionCount);
+
+    std::uniform_real_distribution<double> dis01(0, 1);
+    const double offsetU = dis01(rng), offsetV = dis01(rng);
+
+    // R2 sequence, see Roberts, "The Unreasonable Effectiveness of
+    // Quasirandom Sequences"
+    constexpr double g  = 1.32471795724474602596;
+    constexpr double a1 = 1 / g;
+    constexpr double a2 = 1 / (g * g);
+
+    int evaluatedCount = 0;
+
+    for(long long i = 0; i < sampleCount; ++i)
+    {
+        double u, v;
+        if(params.lowDiscrepancy)
+        {
+            u = offsetU + a1 * static_cast<double>(i + 1);
+            v = offsetV + a2 * static_cast<double>(i + 1);
+            u -= std::floor(u);
+            v -= std::floor(v);
+        }
+        else
+        {
+            u = dis01(rng);
+            v = dis01(rng);
+        }
+
+        // a single exemplar keeps the 2D point set; several are sampled
+        // through the index with the first coordinate alone, which is a 1D
+        // low-discrepancy sequence by itself
+        agz::math::vec2i xy;
+        if(candidates.ranges().size() == 1)
+        {
+            const auto &range = candidates.ranges()[0];
+            xy.x = range.x + std::min(static_cast<int>(u * range.width), range.width - 1);
+            xy.y = range.y + std::min(static_cast<int>(v * range.height), range.height - 1);
+        }
+        else
+            xy = candidates[std::min(static_cast<long long>(u * positionCount), positionCount - 1)];
+
+        addCandidate(mseToXY, scoreCandidate(ctx, xy.x, xy.y, x, y), xy, x, y);
+        ++evaluatedCount;
+    }
+
+    std::vector<agz::math::vec2i> refineCenters;
+    for(auto it = mseToXY.begin(); it != mseToXY.end() &&
+        static_cast<int>(refineCenters.size()) < params.refineCount; ++it)
+    {
+        refineCenters.push_back(it->second);
+    }
+
+    std::vector<agz::math::vec2i> refined;
+    for(auto &center : refineCenters)
+    {
+        // the window is clipped to the exemplar of its centre
+        const auto &range = candidates.ranges()[candidates.rangeOf(center)];
+
+        for(int srcY = std::max(range.y, center.y - params.refineRadius);
+            srcY <= std::min(range.y + range.height - 1, center.y + params.refineRadius); ++srcY)
+        {
+            for(int srcX = std::max(range.x, center.x - params.refineRadius);
+                srcX <= std::min(range.x + range.width - 1, center.x + params.refineRadius); ++srcX)
+            {
+                const agz::math::vec2i xy = { srcX, srcY };
+                if(std::find(refineCenters.begin(), refineCenters.end(), xy) != refineCenters.end() ||
+                   std::find(refined.begin(), refined.end(), xy) != refined.end())
+                    continue;
+
+                refined.push_back(xy);
+                addCandidate(mseToXY, scoreCandidate(ctx, srcX, srcY, x, y), xy, x, y);
+                ++evaluatedCount;
+            }
+        }
+    }
+
+    return evaluatedCount;
+}
+
+int TextureQuilter::scanStridedCandidates(
+    const QuiltContext &ctx,
+    int                 x,
+    int                 y,
+    CandidateMap       &mseToXY) const
+{
+    QUILT_STATS_TIMER(scoring);
+
+    const CandidateIndex &candidates = *ctx.candidates;
+
+    const int stride = stridedParams_.stride > 0 ? stridedParams_.stride :
+        std::clamp(std::min(tileWidth_, tileHeight_) / 16, 1, 8);
+
+    int evaluatedCount = 0;
+
+    // every exemplar has its own grid, anchored at its first position
+    CandidateMap gridMSEToXY;
+    for(auto &range : candidates.ranges())
+    {
+        for(int srcY = range.y; srcY < range.y + range.height; srcY += stride)
+        {
+            for(int srcX = range.x; srcX < range.x + range.width; srcX += stride)
+            {
+                const float mse = scoreCandidate(ctx, srcX, srcY, x, y);
+                addCandidate(gridMSEToXY, mse, { srcX, srcY }, x, y);
+                ++evaluatedCount;
+            }
+        }
+    }
+
+    // the windows partition the source positions among the grid points, so
+    // windows of different grid points never overlap
+    const int windowBegin = -(stride - 1) / 2;
+    const int windowEnd   = windowBegin + stride;
+
+    int refined = 0;
+    for(auto it = gridMSEToXY.begin();
+        it != gridMSEToXY.end() && refined < stridedParams_.refineCount; ++it, ++refined)
+    {
+        const auto center = it->second;
+        const auto &range = candidates.ranges()[candidates.rangeOf(center)];
+
+        for(int srcY = std::max(range.y, center.y + windowBegin);
+            srcY < std::min(range.y + range.height, center.y + windowEnd); ++srcY)
+        {
+            for(int srcX = std::max(range.x, center.x + windowBegin);
+                srcX < std::min(range.x + range.width, center.x + windowEnd); ++srcX)
+            {
+                if((srcX - range.x) % stride == 0 && (srcY - range.y) % stride == 0)
+                    continue;
+
+                const float mse = scoreCandidate(ctx, srcX, srcY, x, y);
+                addCandidate(mseToXY, mse, { srcX, srcY }, x, y);
+                ++evaluatedCount;
+            }
+        }
+    }
+
+    mseToXY.merge(gridMSEToXY);
+
+    return evaluatedCount;
+}
+
+int TextureQuilter::scanPatchMatchCandidates(
+    const QuiltContext         &ctx,
+    int                         tileX,
+    int                         tileY,
+    std::default_random_engine &rng,
+    CandidateMap               &mseToXY) const
+{
+    QUILT_STATS_TIMER(scoring);
+
+    const int x = tileX * (tileWidth_ - seamWidth_);
+    const int y = tileY * (tileHeight_ - seamHeight_);
+
+    const CandidateIndex &candidates = *ctx.candidates;
+
+    // candidate indices, see CandidateIndex::operator[]
+    std::unordered_set<long long> scored;
+    agz::math::vec2i best = { -1, -1 };
+    int bestRange = -1;
+    float bestMSE = std::numeric_limits<float>::max();
+
+    // offsets are clamped into the exemplar of the position they derive from
+    auto evaluate = [&](agz::math::vec2i xy, int range)
+    {
+        xy = candidates.clamp(xy, range);
+
+        const CandidateIndex::Range &r = candidates.ranges()[range];
+        const long long index = r.firstIndex +
+            static_cast<long long>(xy.y - r.y) * r.width + (xy.x - r.x);
+        if(!scored.insert(index).second)
+            return;
+
+        const float mse = scoreCandidate(ctx, xy.x, xy.y, x, y);
+        addCandidate(mseToXY, mse, xy, x, y);
+
+        if(mse < bestMSE && ((x == 0 && y == 0) || mse > 0.001f))
+        {
+            bestMSE   = mse;
+            best      = xy;
+            bestRange = range;
+        }
+    };
+
+    // propagation from placed neighbours: a neighbour's best offset shifted by
+    // the distance between the two tiles continues its content into this tile
+    const int stepX = tileWidth_ - seamWidth_;
+    const int stepY = tileHeight_ - seamHeight_;
+
+    for(auto [dx, dy] : { std::pair{ -1, 0 }, { 0, -1 }, { -1, -1 }, { 1, -1 } })
+    {
+        const int nx = tileX + dx, ny = tileY + dy;
+        if(nx < 0 || ny < 0 || nx >= ctx.tileCountX)
+            continue;
+
+        const auto &neighbour = ctx.tile(nx, ny);
+        if(neighbour.bestCandidate.x < 0)
+            continue;
+
+        evaluate({ neighbour.bestCandidate.x - dx * stepX,
+                   neighbour.bestCandidate.y - dy * stepY },
+                 candidates.rangeOf(neighbour.bestCandidate));
+    }
+
+    // keep drawing until some candidate is usable, within a bound
+    const int initCount    = patchMatchParams_.randomInitCount;
+    const int maxInitCount = std::max(initCount, 1) * PATCHMATCH_MAX_INIT_FACTOR;
+    auto drawMore = [&](int i)
+    {
+        return i < initCount || (best.x < 0 && i < maxInitCount);
+    };
+
+    if(candidates.ranges().size() == 1)
+    {
+        const auto &range = candidates.ranges()[0];
+        std::uniform_int_distribution disX(range.x, range.x + range.width - 1);
+        std::uniform_int_distribution disY(range.y, range.y + range.height - 1);
+
+        for(int i = 0; drawMore(i); ++i)
+        {
+            evaluate({ disX(rng), disY(rng) }, 0);
+            if(static_cast<long long>(scored.size()) >= candidates.size())
+                break;
+        }
+    }
+    else
+    {
+        std::uniform_int_distribution<long long> disIndex(0, candidates.size() - 1);
+
+        for(int i = 0; drawMore(i); ++i)
+        {
+            const agz::math::vec2i xy = candidates[disIndex(rng)];
+            evaluate(xy, candidates.rangeOf(xy));
+            if(static_cast<long long>(scored.size()) >= candidates.size())
+                break;
+        }
+    }
+
+    if(best.x < 0)
+        return static_cast<int>(scored.size());
+
+    const float radiusRatio = std::clamp(patchMatchParams_.radiusRatio, 0.1f, 0.9f);
+
+    for(int iter = 0; iter < patchMatchParams_.iterations; ++iter)
+    {
+        const auto &range = candidates.ranges()[bestRange];
+        for(float radius = static_cast<float>(std::max(range.width, range.height));
+            radius >= 1; radius *= radiusRatio)
+        {
+            const int r = static_cast<int>(radius);
+            std::uniform_int_distribution disOffset(-r, r);
+            evaluate({ best.x + disOffset(rng), best.y + disOffset(rng) }, bestRange);
+        }
+    }
+
+    return static_cast<int>(scored.size());
+}
+
+int TextureQuilter::scanCandidates(
+    const QuiltContext         &ctx,
+    int                         tileX,
+    int                         tileY,
+    std::default_random_engine &rng,
+    CandidateMap               &mseToXY) const
+{
+    const int x = tileX * (tileWidth_ - seamWidth_);
+    const int y = tileY * (tileHeight_ - seamHeight_);
+
+    switch(searchMode_)
+    {
+    case SearchMode::Stochastic:
+        return scanStochasticCandidates(ctx, x, y, rng, mseToXY);
+    case SearchMode::PatchMatch:
+        return scanPatchMatchCandidates(ctx, tileX, tileY, rng, mseToXY);
+    case SearchMode::Strided:
+        return scanStridedCandidates(ctx, x, y, mseToXY);
+    case SearchMode::Exhaustive:
+        break;
+    }
+    return scanAllCandidates(ctx, x, y, mseToXY);
+}
+
+int TextureQuilter::scanCoherentCandidates(
+    const QuiltContext &ctx,
+    int                 tileX,
+    int                 tileY,
+    CandidateMap       &mseToXY,
+    float              &referenceMSE) const
+{
+    QUILT_STATS_TIMER(scoring);
+
+    const int x = tileX * (tileWidth_ - seamWidth_);
+    const int y = tileY * (tileHeight_ - seamHeight_);
+
+    std::vector<agz::math::vec2i> scored;
+    referenceMSE = std::numeric_limits<float>::max();
+
+    // continuations leaving their exemplar are no candidates
+    auto tryContinuation = [&](agz::math::vec2i xy)
+    {
+        if(!ctx.candidates->contains(xy))
+            return;
+        if(std::find(scored.begin(), scored.end(), xy) != scored.end())
+            return;
+
+        scored.push_back(xy);
+        addCandidate(mseToXY, scoreCandidate(ctx, xy.x, xy.y, x, y), xy, x, y);
+    };
+
+    auto continueFrom = [&](const TileRecord &neighbour, agz::math::vec2i step)
+    {
+        referenceMSE = std::min(referenceMSE, neighbour.referenceMSE);
+
+        tryContinuation({ neighbour.source.x + step.x, neighbour.source.y + step.y });
+        for(auto &xy : neighbour.goodCandidates)
+            tryContinuation({ xy.x + step.x, xy.y + step.y });
+    };
+
+    if(tileX > 0)
+        continueFrom(ctx.tile(tileX - 1, tileY), { tileWidth_ - seamWidth_, 0 });
+
+    if(tileY > 0)
+        continueFrom(ctx.tile(tileX, tileY - 1), { 0, tileHeight_ - seamHeight_ });
+
+    return static_cast<int>(scored.size());
+}
+
+agz::math::vec2i TextureQuilter::pickFromToleranceBand(
+    const CandidateMap         &mseToXY,
+    [[maybe_unused]] int        evaluatedCount,
+    std::default_random_engine &rng) const
+{
+    QUILT_STATS_TIMER(selection);
+
+    const float maxAllowedMSE = mseToXY.begin()->first * (1 + tolerance_);
+    std::vector<agz::math::vec2i> allowedXYs;
+
+    for(auto &p : mseToXY)
+    {
+        if(p.first <= maxAllowedMSE)
+            allowedXYs.push_back(p.second);
+        else
+            break;
+    }
+
+    // saturates should the band hold candidates not counted as evaluated
+    QUILT_STATS_ADD(candidatesPruned,
+        std::max<uint64_t>(static_cast<uint64_t>(evaluatedCount), allowedXYs.size()) - allowedXYs.size());
+    QUILT_STATS_ADD(toleranceBandSum, allowedXYs.size());
+    QUILT_STATS_MAX(toleranceBandMax, allowedXYs.size());
+    QUILT_STATS_ADD(bytesAllocated,
+        allowedXYs.capacity() * sizeof(agz::math::vec2i));
+
+    std::uniform_int_distribution dis(
+        0, static_cast<int>(allowedXYs.size() - 1));
+    return allowedXYs[dis(rng)];
+}
+
+agz::math::vec2i TextureQuilter::selectSourceTile(
+    QuiltContext                &ctx,
+    int                          tileX,
+    int                          tileY,
+    std::default_random_engine  &rng) const
+{
+    const CandidateIndex &candidates = *ctx.candidates;
+    TileRecord &record = ctx.tile(tileX, tileY);
+
+    if(!enableMSESelection_)
+    {
+        record.source = randomCandidate(candidates, rng);
+        return record.source;
+    }
+
+    CandidateMap mseToXY;
+    int evaluatedCount = 0;
+
+    if(coherenceCandidates_ > 0 && (tileX > 0 || tileY > 0))
+    {
+        float referenceMSE;
+        evaluatedCount = scanCoherentCandidates(
+            ctx, tileX, tileY, mseToXY, referenceMSE);
+
+        if(!mseToXY.empty() &&
+           mseToXY.begin()->first <= referenceMSE * (1 + tolerance_))
+        {
+            record.referenceMSE = referenceMSE;
+            QUILT_STATS_ADD(coherentSelections, 1);
+        }
+        else
+        {
+            mseToXY.clear();
+        }
+    }
+
+    if(mseToXY.empty())
+    {
+        evaluatedCount += scanCandidates(ctx, tileX, tileY, rng, mseToXY);
+
+        // addCandidate drops near-duplicates of the target, which may be all
+        // scanned candidates, e.g. of flat sources; any of them fits then
+        if(mseToXY.empty())
+            mseToXY.insert({ 0.0f, randomCandidate(candidates, rng) });
+
+        record.referenceMSE = mseToXY.begin()->first;
+    }
+
+    record.bestCandidate = mseToXY.begin()->second;
+    record.bestMSE       = mseToXY.begin()->first;
+    record.evaluatedCandidates = evaluatedCount;
+
+    QUILT_STATS_ADD(candidatesEvaluated, evaluatedCount);
+
+    record.goodCandidates.clear();
+    for(auto it = mseToXY.begin(); it != mseToXY.end() &&
+        static_cast<int>(record.goodCandidates.size()) < coherenceCandidates_; ++it)
+    {
+        record.goodCandidates.push_back(it->second);
+    }
+
+    record.source = pickFromToleranceBand(mseToXY, evaluatedCount, rng);
+    return record.source;
+}
+
+agz::math::vec2i TextureQuilter::selectConstrainedSourceTile(
+    const Texture<Vec3>        &source,
+    const LuminancePlane       &sourceLum,
+    const Texture<Vec3>        &target,
+    const ConstrainedTile      &constrained,
+    std::default_random_engine &rng) const
+{
+    const int x = constrained.x, y = constrained.y;
+
+    // tile positions in the source, at least one as quiltMaskedRegion checks
+    const int rangeX = source.width() - tileWidth_ + 1;
+    const int rangeY = source.height() - tileHeight_ + 1;
+
+    // pixels to match: the union of the constrained overlap bands, as one
+    // span of tile columns per row
+    struct RowSpan
+    {
+        int y, xBeg, xEnd;
+    };
+
+    std::vector<RowSpan> spans;
+    int knownCount = 0;
+
+    for(int yi = 0; yi < tileHeight_; ++yi)
+    {
+        const bool fullRow = (constrained.top    && yi < seamHeight_) ||
+                             (constrained.bottom && yi >= tileHeight_ - seamHeight_);
+        if(fullRow)
+        {
+            spans.push_back({ yi, 0, tileWidth_ });
+            knownCount += tileWidth_;
+            continue;
+        }
+
+        const int leftEnd    = constrained.left  ? seamWidth_ : 0;
+        const int rightBegin = constrained.right ? tileWidth_ - seamWidth_ : tileWidth_;
+
+        if(leftEnd >= rightBegin)
+        {
+            spans.push_back({ yi, 0, tileWidth_ });
+            knownCount += tileWidth_;
+            continue;
+        }
+
+        if(leftEnd > 0)
+        {
+            spans.push_back({ yi, 0, leftEnd });
+            knownCount += leftEnd;
+        }
+
+        if(rightBegin < tileWidth_)
+        {
+            spans.push_back({ yi, rightBegin, tileWidth_ });
+            knownCount += tileWidth_ - rightBegin;
+        }
+    }
+
+    if(!enableMSESelection_ || !knownCount)
+    {
+        std::uniform_int_distribution disX(0, rangeX - 1);
+        std::uniform_int_distribution disY(0, rangeY - 1);
+        return { disX(rng), disY(rng) };
+    }
+
+    std::vector<float> targetLum(tileWidth_ * tileHeight_);
+    for(auto &span : spans)
+    {
+        for(int xi = span.xBeg; xi < span.xEnd; ++xi)
+            targetLum[span.y * tileWidth_ + xi] = target(y + span.y, x + xi).lum();
+    }
+
+    CandidateMap mseToXY;
+
+    {
+        QUILT_STATS_TIMER(scoring);
+
+        for(int srcY = 0; srcY < rangeY; ++srcY)
+        {
+            for(int srcX = 0; srcX < rangeX; ++srcX)
+            {
+                float squaredErrorSum = 0;
+                for(auto &span : spans)
+                {
+                    const float *rowA = sourceLum.row(srcY + span.y) + srcX;
+                    const float *rowB = &targetLum[span.y * tileWidth_];
+                    for(int xi = span.xBeg; xi < span.xEnd; ++xi)
+                        squaredErrorSum += agz::math::sqr(rowA[xi] - rowB[xi]);
+                }
+
+                mseToXY.insert({ squaredErrorSum / knownCount, { srcX, srcY } });
+            }
+        }
+    }
+
+    // The best matches are often the source position the patch to replace
+    // was taken from. Drop candidates reproducing at least half of the masked
+    // pixels (the rest may have been covered by neighbours) from the
+    // tolerance band; only the few candidates there are compared.
+    auto reproducesMaskedPixels = [&](agz::math::vec2i xy)
+    {
+        if(constrained.maskedLum.empty())
+            return false;
+
+        size_t reproduced = 0;
+        for(auto &[index, lum] : constrained.maskedLum)
+        {
+            const int yi = index / tileWidth_, xi = index % tileWidth_;
+            reproduced += std::abs(sourceLum(xy.y + yi, xy.x + xi) - lum) <= 1.0f / 255;
+        }
+        return 2 * reproduced >= constrained.maskedLum.size();
+    };
+
+    // the best candidate, should the band hold only reproducing ones
+    const auto fallback = *mseToXY.begin();
+    float maxAllowedMSE = std::numeric_limits<float>::max();
+
+    for(auto it = mseToXY.begin(); it != mseToXY.end() && it->first <= maxAllowedMSE;)
+    {
+        if(reproducesMaskedPixels(it->second))
+        {
+            it = mseToXY.erase(it);
+            continue;
+        }
+
+        if(maxAllowedMSE == std::numeric_limits<float>::max())
+            maxAllowedMSE = it->first * (1 + tolerance_);
+        ++it;
+    }
+
+    if(mseToXY.empty())
+        mseToXY.insert(fallback);
+
+    const int evaluatedCount = rangeX * rangeY;
+    QUILT_STATS_ADD(candidatesEvaluated, evaluatedCount);
+
+    return pickFromToleranceBand(mseToXY, evaluatedCount, rng);
+}
+
+void TextureQuilter::placeConstrainedTile(
+    const Texture<Vec3>   &source,
+    Texture<Vec3>         &target,
+    agz::math::vec2i       xy,
+    const ConstrainedTile &constrained,
+    std::vector<char>     *coverage) const
+{
+    const int x = constrained.x, y = constrained.y;
+
+    const auto tile = source.subview(
+        xy.y, xy.y + tileHeight_, xy.x, xy.x + tileWidth_);
+
+    // seams towards the right and bottom neighbours keep the tile on the
+    // near side, so there the tile is the first texture of the seam DP
+    std::vector<int> leftSeam, topSeam, rightSeam, bottomSeam;
+    if(enableMinCut_)
+    {
+        ScopedTraceEvent traceSeam(traceRecorder_.get(), "seam", x, y);
+
+        if(constrained.left)
+        {
+            leftSeam = findVerticalMinCostSeam(
+                target, tile, x, y, 0, 0, seamWidth_, tileHeight_);
+        }
+
+        if(constrained.top)
+        {
+            topSeam = findHorizontalMinCostSeam(
+                target, tile, x, y, 0, 0, tileWidth_, seamHeight_);
+        }
+
+        if(constrained.right || constrained.bottom)
+        {
+            const Texture<Vec3> tileCopy = source.subtex(
+                xy.y, xy.y + tileHeight_, xy.x, xy.x + tileWidth_);
+            const auto existing = target.subview(
+                y, y + tileHeight_, x, x + tileWidth_);
+
+            const int bandX = tileWidth_ - seamWidth_;
+            const int bandY = tileHeight_ - seamHeight_;
+
+            if(constrained.right)
+            {
+                rightSeam = findVerticalMinCostSeam(
+                    tileCopy, existing, bandX, 0, bandX, 0, seamWidth_, tileHeight_);
+                for(int &seamX : rightSeam)
+                    seamX += bandX;
+            }
+
+            if(constrained.bottom)
+            {
+                bottomSeam = findHorizontalMinCostSeam(
+                    tileCopy, existing, 0, bandY, 0, bandY, tileWidth_, seamHeight_);
+                for(int &seamY : bottomSeam)
+                    seamY += bandY;
+            }
+        }
+    }
+
+    QUILT_STATS_TIMER(placement);
+
+    if(coverage)
+        coverage->assign(tileWidth_ * tileHeight_, 0);
+
+    for(int yi = 0; yi < tileHeight_; ++yi)
+    {
+        for(int xi = 0; xi < tileWidth_; ++xi)
+        {
+            if(!leftSeam.empty() && xi <= leftSeam[yi])
+                continue;
+            if(!topSeam.empty() && yi <= topSeam[xi])
+                continue;
+            if(!rightSeam.empty() && xi > rightSeam[yi])
+                continue;
+            if(!bottomSeam.empty() && yi > bottomSeam[xi])
+                continue;
+            target(y + yi, x + xi) = tile(yi, xi);
+
+            if(coverage)
+                (*coverage)[yi * tileWidth_ + xi] = 1;
+        }
+    }
+}
+
+void TextureQuilter::placeSelectedTile(
+    QuiltContext &ctx,
+    TileRecord   &record,
+    int           x,
+    int           y) const
+{
+    const CandidateIndex::Candidate candidate = ctx.candidates->resolve(record.source);
+    const agz::math::vec2i xy = candidate.position;
+
+    const bool wrapRight  = ctx.wrapsRight(x, tileWidth_);
+    const bool wrapBottom = ctx.wrapsBottom(y, tileHeight_);
+
+    auto updateStatistics = [&](const auto &target)
+    {
+        if(ctx.targetStats)
+            ctx.targetStats->update(target, x, y, tileWidth_, tileHeight_);
+
+        if(ctx.targetFixedPoint)
+            ctx.targetFixedPoint->update(target, x, y, tileWidth_, tileHeight_);
+    };
+
+    if(!candidate.transform->isIdentity() && ctx.blockedTarget)
+    {
+        const DihedralTileView<BlockedTexture<Vec3>> tile(
+            *ctx.blockedSource, *candidate.transform, xy.x, xy.y, tileWidth_, tileHeight_);
+        placeTile(tile, *ctx.blockedTarget, x, y, record, wrapRight, wrapBottom);
+        updateStatistics(*ctx.blockedTarget);
+    }
+    else if(!candidate.transform->isIdentity())
+    {
+        const DihedralTileView<Texture<Vec3>> tile(
+            *ctx.source, *candidate.transform, xy.x, xy.y, tileWidth_, tileHeight_);
+        placeTile(tile, *ctx.target, x, y, record, wrapRight, wrapBottom);
+        updateStatistics(*ctx.target);
+    }
+    else if(ctx.blockedTarget)
+    {
+        const auto tile = ctx.blockedSource->subview(
+            xy.y, xy.y + tileHeight_, xy.x, xy.x + tileWidth_);
+        placeTile(tile, *ctx.blockedTarget, x, y, record, wrapRight, wrapBottom);
+        updateStatistics(*ctx.blockedTarget);
+    }
+    else
+    {
+        const auto tile = ctx.source->subview(
+            xy.y, xy.y + tileHeight_, xy.x, xy.x + tileWidth_);
+        placeTile(tile, *ctx.target, x, y, record, wrapRight, wrapBottom);
+        updateStatistics(*ctx.target);
+    }
+}
+
+template<typename TileView, typename TargetTexture>
+void TextureQuilter::placeTile(
+    const TileView &tile,
+    TargetTexture  &target,
+    int             x,
+    int             y,
+    TileRecord     &record,
+    bool            wrapRight,
+    bool            wrapBottom) const
+{
+    record.leftSeam.clear();
+    record.topSeam.clear();
+
+    if(!enableMinCut_)
+    {
+        QUILT_STATS_TIMER(placement);
+
+        for(int yi = 0; yi < tile.height(); ++yi)
+        {
+            for(int xi = 0; xi < tile.width(); ++xi)
+            {
+                target(y + yi, x + xi) = tile(yi, xi);
+            }
+        }
+        return;
+    }
+
+    std::vector<int> &verticalSeam = record.leftSeam, &horizontalSeam = record.topSeam;
+    std::vector<int> rightSeam, bottomSeam;
+    const int rightX  = tileWidth_ - seamWidth_;
+    const int bottomY = tileHeight_ - seamHeight_;
+    {
+        ScopedTraceEvent traceSeam(traceRecorder_.get(), "seam", x, y);
+
+        if(x > 0)
+        {
+            verticalSeam = findVerticalMinCostSeam(
+                target, tile, x, y, 0, 0, seamWidth_, tileHeight_);
+        }
+
+        if(y > 0)
+        {
+            horizontalSeam = findHorizontalMinCostSeam(
+                target, tile, x, y, 0, 0, tileWidth_, seamHeight_);
+        }
+
+        // across the wrap-around the tile is the first of the pair
+        if(wrapRight)
+        {
+            rightSeam = findVerticalMinCostSeam(
+                tile, target, rightX, 0, x + rightX, y, seamWidth_, tileHeight_);
+        }
+
+        if(wrapBottom)
+        {
+            bottomSeam = findHorizontalMinCostSeam(
+                tile, target, 0, bottomY, x, y + bottomY, tileWidth_, seamHeight_);
+        }
+    }
+
+    QUILT_STATS_TIMER(placement);
+
+    for(int yi = 0; yi < tile.height(); ++yi)
+    {
+        for(int xi = 0; xi < tile.width(); ++xi)
+        {
+            if(!verticalSeam.empty() && xi <= verticalSeam[yi])
+                continue;
+            if(!horizontalSeam.empty() && yi <= horizontalSeam[xi])
+                continue;
+            if(!rightSeam.empty() && xi - rightX > rightSeam[yi])
+                continue;
+            if(!bottomSeam.empty() && yi - bottomY > bottomSeam[xi])
+                continue;
+            target(y + yi, x + xi) = tile(yi, xi);
         }
     }
 }
@@ -0,0 +1,225 @@
+#include "../include/TileScheduler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+TileScheduler::TileScheduler(int threadCount, const NUMATopology *topology)
+{
+    threadCount = std::max(1, threadCount);
+    nodeCount_  = topology ? std::min(topology->nodeCount(), threadCount) : 1;
+
+    // (node, cpu) pairs taking one CPU of every node in turn, so that any
+    // number of workers is spread evenly over the nodes
+    std::vector<std::pair<int, int>> slots;
+    if(topology)
+    {
+        size_t maxCPUs = 0;
+        for(auto &node : topology->nodes())
+            maxCPUs = std::max(maxCPUs, node.cpus.size());
+
+        for(size_t i = 0; i < maxCPUs; ++i)
+        {
+            for(int n = 0; n < nodeCount_; ++n)
+            {
+                auto &cpus = topology->nodes()[n].cpus;
+                if(i < cpus.size())
+                    slots.push_back({ n, cpus[i] });
+            }
+        }
+    }
+
+    std::vector<int> nodeWorkers(nodeCount_, 0);
+    for(int i = 0; i < threadCount; ++i)
+    {
+        Worker worker;
+        worker.index = i;
+
+        int cpu = -1;
+        if(!slots.empty())
+        {
+            worker.node = slots[i % slots.size()].first;
+            cpu         = slots[i % slots.size()].second;
+        }
+        worker.nodeRank = nodeWorkers[worker.node]++;
+
+        workers_.push_back(worker);
+        workerCPUs_.push_back(cpu);
+    }
+}
+
+void TileScheduler::setWorkerInit(std::function<void(const Worker &)> init)
+{
+    workerInit_ = std::move(init);
+}
+
+int TileScheduler::nodeOfRow(int tileY, int tileCountY) const noexcept
+{
+    return std::clamp(tileY * nodeCount_ / std::max(1, tileCountY), 0, nodeCount_ - 1);
+}
+
+void TileScheduler::run(
+    int             tileCountX,
+    int             tileCountY,
+    const TileTask &task,
+    bool            wrapAround)
+{
+    if(threadCount() <= 1)
+    {
+        runSequential(tileCountX, tileCountY, task);
+        return;
+    }
+
+    const int tileCount = tileCountX * tileCountY;
+
+    std::vector<int> pendingDependencies(tileCount);
+    for(int y = 0; y < tileCountY; ++y)
+    {
+        for(int x = 0; x < tileCountX; ++x)
+        {
+            pendingDependencies[y * tileCountX + x] =
+                (x > 0) + (y > 0) + (y > 0 && x + 1 < tileCountX);
+        }
+    }
+
+    const int wrapTile = (tileCountY - 1) * tileCountX;
+    wrapAround = wrapAround && tileCountX > 1 && tileCountY > 1;
+    if(wrapAround)
+        ++pendingDependencies[wrapTile];
+
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    std::vector<std::deque<int>> readyTiles(nodeCount_);
+    int finishedTiles = 0;
+    int initializedWorkers = 0;
+    std::exception_ptr error;
+
+    auto nodeOfTile = [&](int tile)
+    {
+        return nodeOfRow(tile / tileCountX, tileCountY);
+    };
+
+    if(tileCount > 0)
+        readyTiles[nodeOfTile(0)].push_back(0);
+
+    // called with the mutex held
+    auto finishTile = [&](int tile)
+    {
+        ++finishedTiles;
+
+        const int x = tile % tileCountX, y = tile / tileCountX;
+        auto release = [&](int dx, int dy)
+        {
+            const int nx = x + dx, ny = y + dy;
+            if(nx < 0 || nx >= tileCountX || ny >= tileCountY)
+                return;
+
+            const int dependent = ny * tileCountX + nx;
+            if(--pendingDependencies[dependent] == 0)
+                readyTiles[nodeOfTile(dependent)].push_back(dependent);
+        };
+
+        release(1, 0);
+        release(0, 1);
+        release(-1, 1);
+
+        if(wrapAround && tile == tileCountX - 1 && --pendingDependencies[wrapTile] == 0)
+            readyTiles[nodeOfTile(wrapTile)].push_back(wrapTile);
+    };
+
+    auto workerMain = [&](const Worker &worker, int cpu)
+    {
+        if(cpu >= 0)
+            pinCurrentThreadToCPU(cpu);
+
+        try
+        {
+            if(workerInit_)
+                workerInit_(worker);
+        }
+        catch(...)
+        {
+            std::lock_guard lk(mutex);
+            if(!error)
+                error = std::current_exception();
+        }
+
+        std::unique_lock lk(mutex);
+
+        // no tile may run before every worker finished its initialization
+        if(++initializedWorkers == threadCount())
+            cond.notify_all();
+        cond.wait(lk, [&] { return initializedWorkers == threadCount(); });
+
+        for(;;)
+        {
+            int tile = -1;
+            cond.wait(lk, [&]
+            {
+                if(error || finishedTiles == tileCount)
+                    return true;
+
+                // own node first, then steal from the others
+                for(int i = 0; i < nodeCount_; ++i)
+                {
+                    auto &queue = readyTiles[(worker.node + i) % nodeCount_];
+                    if(!queue.empty())
+                    {
+                        tile = queue.front();
+                        queue.pop_front();
+                        return true;
+                    }
+                }
+                return false;
+            });
+
+            if(tile < 0)
+                break;
+
+            lk.unlock();
+            try
+            {
+                task(tile % tileCountX, tile / tileCountX, worker);
+            }
+            catch(...)
+            {
+                lk.lock();
+                if(!error)
+                    error = std::current_exception();
+                cond.notify_all();
+                break;
+            }
+            lk.lock();
+
+            finishTile(tile);
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(int i = 0; i < threadCount(); ++i)
+        threads.emplace_back(workerMain, workers_[i], workerCPUs_[i]);
+
+    for(auto &thread : threads)
+        thread.join();
+
+    if(error)
+        std::rethrow_exception(error);
+}
+
+void TileScheduler::runSequential(
+    int tileCountX, int tileCountY, const TileTask &task)
+{
+    if(workerInit_)
+        workerInit_(workers_[0]);
+
+    for(int y = 0; y < tileCountY; ++y)
+    {
+        for(int x = 0; x < tileCountX; ++x)
+            task(x, y, workers_[0]);
+    }
+}
@@ -0,0 +1,126 @@
+#include "../include/TraceRecorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    std::atomic<uint64_t> nextRecorderID{ 1 };
+
+    struct ThreadBufferCache
+    {
+        uint64_t recorderID = 0;
+        void    *buffer     = nullptr;
+    };
+
+    thread_local ThreadBufferCache threadBufferCache;
+}
+
+TraceRecorder::TraceRecorder(size_t eventsPerThread)
+    : id_(nextRecorderID++),
+      eventsPerThread_(eventsPerThread > 0 ? eventsPerThread : 1),
+      epoch_(std::chrono::steady_clock::now())
+{
+
+}
+
+uint64_t TraceRecorder::now() const noexcept
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<
+        std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch_).count());
+}
+
+void TraceRecorder::record(
+    const char *name, int x, int y,
+    uint64_t beginNs, uint64_t endNs)
+{
+    auto &buffer = threadBuffer();
+    auto &event = buffer.events[buffer.written % eventsPerThread_];
+    event = { name, x, y, pass_, beginNs, endNs };
+    ++buffer.written;
+}
+
+void TraceRecorder::clear()
+{
+    std::lock_guard lk(mutex_);
+    for(auto &buffer : buffers_)
+        buffer->written = 0;
+    pass_ = 0;
+}
+
+void TraceRecorder::setPass(int pass) noexcept
+{
+    pass_ = pass;
+}
+
+void TraceRecorder::writeChromeTrace(std::ostream &out) const
+{
+    std::lock_guard lk(mutex_);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    auto separator = [&]
+    {
+        if(!first)
+            out << ",\n";
+        first = false;
+    };
+
+    for(auto &buffer : buffers_)
+    {
+        separator();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << buffer->threadIndex << ",\"args\":{\"name\":\"quilt worker "
+            << buffer->threadIndex << "\"}}";
+
+        const uint64_t count = std::min<uint64_t>(
+            buffer->written, eventsPerThread_);
+        const uint64_t start = buffer->written - count;
+
+        for(uint64_t i = start; i < buffer->written; ++i)
+        {
+            const auto &event = buffer->events[i % eventsPerThread_];
+
+            separator();
+            out << "{\"name\":\"" << event.name << "\",\"cat\":\"tile\""
+                << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadIndex
+                << ",\"ts\":"  << static_cast<double>(event.beginNs) / 1000
+                << ",\"dur\":" << static_cast<double>(
+                                      event.endNs - event.beginNs) / 1000
+                << ",\"args\":{\"x\":" << event.x
+                << ",\"y\":" << event.y
+                << ",\"pass\":" << event.pass << "}}";
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+void TraceRecorder::save(const std::string &filename) const
+{
+    std::ofstream fout(filename, std::ofstream::out | std::ofstream::trunc);
+    if(!fout)
+        throw std::runtime_error("failed to open trace file: " + filename);
+    writeChromeTrace(fout);
+}
+
+TraceRecorder::ThreadBuffer &TraceRecorder::threadBuffer()
+{
+    if(threadBufferCache.recorderID == id_)
+        return *static_cast<ThreadBuffer*>(threadBufferCache.buffer);
+
+    std::lock_guard lk(mutex_);
+
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->threadIndex = static_cast<int>(buffers_.size());
+    buffer->events.resize(eventsPerThread_);
+
+    threadBufferCache = { id_, buffer.get() };
+    buffers_.push_back(std::move(buffer));
+
+    return *buffers_.back();
+}
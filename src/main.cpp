@@ -1,8 +1,12 @@
-#include <agz-utils/file.h>
-#include <agz-utils/image.h>
-#include <agz-utils/string.h>
 #include <cxxopts.hpp>
+#include <filesystem>
+#include <thread>
 
+#include "HugePages.h"
+#include "ImageIO.h"
+#include "LazyQuilter.h"
+#include "NUMATopology.h"
+#include "QuiltStats.h"
 #include "TextureQuilter.h"
 
 struct ProgramArgs
@@ -10,6 +14,29 @@ struct ProgramArgs
     std::string inputFile;
     std::string outputFile;
 
+    // "-" streams need explicit formats
+    std::string inputFormat;
+    std::string outputFormat;
+
+    // deflate level of PNG output
+    int compression = 6;
+
+    std::string existingFile;
+    std::string maskFile;
+
+    std::string extendStateFile;
+    std::string saveStateFile;
+
+    std::optional<agz::math::vec2i> region;
+
+    std::string saveMapFile;
+    std::string renderMapFile;
+
+    std::string guideFile;
+    float       transferAlpha  = 0.1f;
+    int         transferPasses = 1;
+    int         mipLevels = 1;
+
     int outputWidth  = 0;
     int outputHeight = 0;
 
@@ -21,16 +48,54 @@ struct ProgramArgs
 
     bool enableMSESelection = false;
     bool enableMinCut        = false;
+    bool enableFastMetric    = false;
+    bool enableFixedPoint    = false;
+    bool enableBlocked       = false;
+    bool enableTransforms    = false;
+    bool enableToroidal      = false;
+
+    int coherenceCandidates = 0;
+
+    std::string searchMode;
+    float       samples     = 0;
+    int         refineCount = 4;
+    int         stride      = 0;
 
     float tolerance = 0;
+
+    int  threads    = 1;
+    bool enableNUMA = false;
+
+    std::optional<unsigned> seed;
+
+    std::string hugePages;
+
+    std::string statsFile;
+    std::string traceFile;
+
+    std::string progress;
 };
 
 std::optional<ProgramArgs> parseArguments(int argc, char *argv[])
 {
     cxxopts::Options options("TextureQuilting");
     options.add_options()
-        ("input",      "Input image file",      cxxopts::value<std::string>())
-        ("output",     "Output image file",     cxxopts::value<std::string>())
+        ("input",      "Input image file (- for stdin), or comma-separated exemplars to quilt from together", cxxopts::value<std::string>())
+        ("output",     "Output image file, - for stdout", cxxopts::value<std::string>())
+        ("format",     "Output image format: png, png16, jpg, bmp, ppm, pfm or hft (default: by extension)", cxxopts::value<std::string>())
+        ("inputFormat", "Format of images read from stdin (default: --format)", cxxopts::value<std::string>())
+        ("compression", "PNG deflate level 0-9, 1 for fast intermediate assets (default: 6)", cxxopts::value<int>())
+        ("existing",   "Existing texture to repair (with --mask, replaces --width/--height)", cxxopts::value<std::string>())
+        ("mask",       "Mask of the region of --existing to re-quilt (white = re-quilt)", cxxopts::value<std::string>())
+        ("extend",     "Quilt state of a previous run to grow to --width/--height", cxxopts::value<std::string>())
+        ("saveState",  "Write the quilt state of the output, for --extend", cxxopts::value<std::string>())
+        ("saveMap",    "Write the quilt map (source positions and seams) of the output", cxxopts::value<std::string>())
+        ("renderMap",  "Render a saved quilt map with --input instead of quilting (replaces --width/--height)", cxxopts::value<std::string>())
+        ("guide",      "Texture transfer: follow this image's luminance (replaces --width/--height)", cxxopts::value<std::string>())
+        ("alpha",      "Texture transfer: overlap vs. guide weight of the first pass", cxxopts::value<float>())
+        ("passes",     "Texture transfer: passes with tiles shrinking by a third", cxxopts::value<int>())
+        ("mipLevels",  "With --renderMap: levels of the output mip chain to render, 0 for all", cxxopts::value<int>())
+        ("region",     "Render the --width x --height region at x,y of an unbounded lazily quilted texture", cxxopts::value<std::string>())
         ("width",      "Output image width",    cxxopts::value<int>())
         ("height",     "Output image height",   cxxopts::value<int>())
         ("tileW",      "Tile width",            cxxopts::value<int>())
@@ -39,7 +104,24 @@ std::optional<ProgramArgs> parseArguments(int argc, char *argv[])
         ("seamH",      "Seam height",           cxxopts::value<int>())
         ("mseSelect",  "Enable MSE selection",  cxxopts::value<bool>())
         ("minCut",     "Enable min cost cut",   cxxopts::value<bool>())
+        ("fastMetric", "Score candidates from precomputed luminance statistics", cxxopts::value<bool>())
+        ("fixedPoint", "Score candidates on 16-bit fixed-point luminance", cxxopts::value<bool>())
+        ("blocked",    "Keep textures in 32x32 blocks during synthesis", cxxopts::value<bool>())
+        ("transforms", "Also use rotated and mirrored source tiles as candidates", cxxopts::value<bool>())
+        ("toroidal",   "Make the output tile seamlessly", cxxopts::value<bool>())
+        ("coherence",  "Try continuations of neighbour tiles (and this many cached candidates) first", cxxopts::value<int>())
+        ("search",     "Candidate search: exhaustive, stochastic, patchmatch or strided", cxxopts::value<std::string>())
+        ("samples",    "Stochastic search budget: count if >= 1, else fraction", cxxopts::value<float>())
+        ("refine",     "Stochastic/strided search: refine around this many best samples", cxxopts::value<int>())
+        ("stride",     "Strided search: grid stride, 0 picks it from the tile size", cxxopts::value<int>())
         ("tolerance",  "Selection tolerance",   cxxopts::value<float>())
+        ("threads",    "Threads placing tiles, 0 for all hardware threads", cxxopts::value<int>())
+        ("numa",       "Pin threads and place memory per NUMA node, print the topology", cxxopts::value<bool>())
+        ("hugePages",  "Huge pages for large buffers: off, thp or explicit", cxxopts::value<std::string>())
+        ("seed",       "Random seed, results are then independent of --threads", cxxopts::value<unsigned>())
+        ("stats",      "Write timing/counter report (.json or .csv)", cxxopts::value<std::string>())
+        ("trace",      "Write Chrome trace of tile events (.json)",    cxxopts::value<std::string>())
+        ("progress",   "Progress output: tty, json or none",           cxxopts::value<std::string>())
         ("help",       "Display help");
 
     const auto args = options.parse(argc, argv);
@@ -56,8 +138,40 @@ std::optional<ProgramArgs> parseArguments(int argc, char *argv[])
     {
         result.inputFile  = args["input"] .as<std::string>();
         result.outputFile = args["output"].as<std::string>();
-        result.outputWidth    = args["width"] .as<int>();
-        result.outputHeight   = args["height"].as<int>();
+        if(args.count("renderMap"))
+            result.renderMapFile = args["renderMap"].as<std::string>();
+        else if(args.count("guide"))
+            result.guideFile = args["guide"].as<std::string>();
+        else if(args.count("existing") || args.count("mask"))
+        {
+            result.existingFile = args["existing"].as<std::string>();
+            result.maskFile     = args["mask"]    .as<std::string>();
+        }
+        else
+        {
+            result.outputWidth  = args["width"] .as<int>();
+            result.outputHeight = args["height"].as<int>();
+        }
+        if(args.count("extend"))
+            result.extendStateFile = args["extend"].as<std::string>();
+        if(args.count("saveState"))
+            result.saveStateFile = args["saveState"].as<std::string>();
+        if(args.count("alpha"))
+            result.transferAlpha = args["alpha"].as<float>();
+        if(args.count("passes"))
+            result.transferPasses = args["passes"].as<int>();
+        if(args.count("mipLevels"))
+            result.mipLevels = args["mipLevels"].as<int>();
+        if(args.count("saveMap"))
+            result.saveMapFile = args["saveMap"].as<std::string>();
+        if(args.count("region"))
+        {
+            const std::string region = args["region"].as<std::string>();
+            const size_t comma = region.find(',');
+            result.region = agz::math::vec2i(
+                std::stoi(region.substr(0, comma)),
+                std::stoi(region.substr(comma + 1)));
+        }
         result.tileWidth     = args["tileW"].as<int>();
         result.tileHeight    = args["tileH"].as<int>();
 
@@ -81,10 +195,79 @@ std::optional<ProgramArgs> parseArguments(int argc, char *argv[])
         else
             result.enableMinCut = true;
 
+        if(args.count("fastMetric"))
+            result.enableFastMetric = args["fastMetric"].as<bool>();
+
+        if(args.count("fixedPoint"))
+            result.enableFixedPoint = args["fixedPoint"].as<bool>();
+
+        if(args.count("blocked"))
+            result.enableBlocked = args["blocked"].as<bool>();
+
+        if(args.count("transforms"))
+            result.enableTransforms = args["transforms"].as<bool>();
+
+        if(args.count("toroidal"))
+            result.enableToroidal = args["toroidal"].as<bool>();
+
+        if(args.count("coherence"))
+            result.coherenceCandidates = args["coherence"].as<int>();
+
+        if(args.count("search"))
+            result.searchMode = args["search"].as<std::string>();
+        else
+            result.searchMode = "exhaustive";
+
+        if(args.count("samples"))
+            result.samples = args["samples"].as<float>();
+        else
+            result.samples = 0.05f;
+
+        if(args.count("refine"))
+            result.refineCount = args["refine"].as<int>();
+
+        if(args.count("stride"))
+            result.stride = args["stride"].as<int>();
+
         if(args.count("tolerance"))
             result.tolerance = args["tolerance"].as<float>();
         else
             result.tolerance = 0.1f;
+
+        if(args.count("threads"))
+            result.threads = args["threads"].as<int>();
+
+        if(args.count("numa"))
+            result.enableNUMA = args["numa"].as<bool>();
+
+        if(args.count("seed"))
+            result.seed = args["seed"].as<unsigned>();
+
+        if(args.count("hugePages"))
+            result.hugePages = args["hugePages"].as<std::string>();
+        else
+            result.hugePages = "off";
+
+        if(args.count("stats"))
+            result.statsFile = args["stats"].as<std::string>();
+
+        if(args.count("trace"))
+            result.traceFile = args["trace"].as<std::string>();
+
+        if(args.count("format"))
+            result.outputFormat = args["format"].as<std::string>();
+
+        result.inputFormat = args.count("inputFormat") ?
+            args["inputFormat"].as<std::string>() : result.outputFormat;
+
+        if(args.count("compression"))
+            result.compression = args["compression"].as<int>();
+
+        // the progress bar shares stdout with the image when streaming it
+        if(args.count("progress"))
+            result.progress = args["progress"].as<std::string>();
+        else
+            result.progress = result.outputFile == "-" ? "none" : "tty";
     }
     catch(...)
     {
@@ -97,10 +280,6 @@ std::optional<ProgramArgs> parseArguments(int argc, char *argv[])
 
 void execute(int argc, char *argv[])
 {
-    using namespace agz;
-    using namespace img;
-    using namespace stdstr;
-
     const auto args = parseArguments(argc, argv);
     if(!args)
         return;
@@ -112,36 +291,249 @@ void execute(int argc, char *argv[])
         args->tolerance);
     quilter.enableMSESelection(args->enableMSESelection);
     quilter.enableMinCut(args->enableMinCut);
+    quilter.enableFastMetric(args->enableFastMetric);
+    quilter.enableFixedPointMetric(args->enableFixedPoint);
+    quilter.enableBlockedStorage(args->enableBlocked);
+    quilter.enableTransformedCandidates(args->enableTransforms);
+    quilter.enableToroidal(args->enableToroidal);
+    quilter.enableCoherenceSearch(args->coherenceCandidates);
+
+    if(args->searchMode == "stochastic")
+    {
+        StochasticSearchParams params;
+        if(args->samples >= 1)
+            params.sampleCount = static_cast<int>(args->samples);
+        else
+            params.sampleFraction = args->samples;
+        params.refineCount = args->refineCount;
+
+        quilter.setSearchMode(SearchMode::Stochastic);
+        quilter.setStochasticSearchParams(params);
+    }
+    else if(args->searchMode == "strided")
+    {
+        StridedSearchParams params;
+        params.stride      = args->stride;
+        params.refineCount = args->refineCount;
+
+        quilter.setSearchMode(SearchMode::Strided);
+        quilter.setStridedSearchParams(params);
+    }
+    else if(args->searchMode == "patchmatch")
+        quilter.setSearchMode(SearchMode::PatchMatch);
+    else if(args->searchMode != "exhaustive")
+        throw std::runtime_error("unknown search mode: " + args->searchMode);
+    quilter.setTraceFile(args->traceFile);
+
+    // NUMA placement only applies to tiles placed in parallel
+    if(args->enableNUMA && args->threads == 1)
+        throw std::runtime_error("--numa needs --threads other than 1");
+
+    quilter.setThreadCount(args->threads);
+    quilter.enableNUMA(args->enableNUMA);
+    if(args->seed)
+        quilter.setSeed(*args->seed);
+
+    // stdout may carry the output image
+    std::ostream &log = args->outputFile == "-" ? std::cerr : std::cout;
+
+    if(args->enableNUMA)
+        NUMATopology::detect().writeReport(log);
 
-    auto sourceTexture = Texture<Vec3>(load_rgb_from_file(
-        args->inputFile).map(
-            [](const math::color3b &c)
+    if(args->hugePages == "thp")
+        setHugePagePolicy(HugePageMode::Transparent);
+    else if(args->hugePages == "explicit")
+        setHugePagePolicy(HugePageMode::Explicit);
+    else if(args->hugePages != "off")
+        throw std::runtime_error("unknown huge page mode: " + args->hugePages);
+
+    if(args->progress == "json")
+        quilter.setProgressReporter(
+            std::make_shared<JSONLinesProgressReporter>(std::cerr));
+    else if(args->progress == "none")
+        quilter.setProgressReporter(nullptr);
+    else if(args->progress == "tty" && args->outputFile == "-")
+        throw std::runtime_error("--progress tty writes to stdout, which carries the output image");
+    else if(args->progress != "tty")
+        throw std::runtime_error(
+            "unknown progress reporter: " + args->progress);
+
+    // by file extension when null
+    const ImageFormat *inputFormat  = nullptr;
+    const ImageFormat *outputFormat = nullptr;
+    if(!args->inputFormat.empty())
+        inputFormat = &parseImageFormat(args->inputFormat);
+    if(!args->outputFormat.empty())
+        outputFormat = &parseImageFormat(args->outputFormat);
+
+    if(args->outputFile == "-" && args->mipLevels != 1)
+        throw std::runtime_error("--mipLevels writes one file per level and needs an --output file");
+
+    if(!args->statsFile.empty() && !QUILT_STATS_ENABLED)
+    {
+        throw std::runtime_error(
+            "--stats needs statistics, configure with -DIMAGE_QUILTING_STATS=ON");
+    }
+
+    if(args->compression < 0 || args->compression > 9)
+        throw std::runtime_error("--compression must be between 0 and 9");
+
+    ImageWriterOptions writerOptions;
+    writerOptions.compressionLevel = args->compression;
+    writerOptions.threads = args->threads > 0 ? args->threads :
+        static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    // only stdin needs the explicit format, named files go by extension
+    auto loadTexture = [&](const std::string &filename)
+    {
+        return loadImage(filename, filename == "-" ? inputFormat : nullptr);
+    };
+
+    const bool quilting = args->renderMapFile.empty() && args->existingFile.empty() &&
+                          args->guideFile.empty() && !args->region;
+    if(!quilting && (!args->saveStateFile.empty() || !args->saveMapFile.empty()))
+        throw std::runtime_error("--saveState and --saveMap need a quilting run");
+
+    std::vector<Texture<Vec3>> exemplars;
+    for(size_t begin = 0; begin <= args->inputFile.size();)
+    {
+        const size_t end = std::min(args->inputFile.find(',', begin), args->inputFile.size());
+        exemplars.push_back(loadTexture(args->inputFile.substr(begin, end - begin)));
+        begin = end + 1;
+    }
+
+    // several exemplars are packed into an atlas, which is also the source
+    // of maps quilted from them
+    std::optional<SourceAtlas> atlas;
+    if(exemplars.size() > 1)
+    {
+        if(!args->existingFile.empty() || !args->guideFile.empty() || args->region)
+            throw std::runtime_error("--existing, --guide and --region take a single --input");
+        atlas.emplace(exemplars);
+    }
+
+    const Texture<Vec3> &sourceTexture = atlas ? atlas->texture() : exemplars[0];
+
+    QuiltQuality quality;
+    QuiltState state;
+    QuiltMap map;
+
+    // only collected when saved, which toroidal quilting does not support
+    QuiltState *statePtr = args->saveStateFile.empty() ? nullptr : &state;
+    QuiltMap   *mapPtr   = args->saveMapFile.empty()   ? nullptr : &map;
+    Texture<Vec3> outputTexture;
+    std::vector<Texture<Vec3>> mipLevels;
+
+    // quilted rows are encoded while later tile rows are still synthesized,
+    // unless the format is only saved as a whole
+    std::unique_ptr<ImageWriter> outputWriter;
+    if(quilting && (outputFormat || args->outputFile != "-") &&
+       (outputFormat ? outputFormat : &imageFormatOfFile(args->outputFile))->streamable())
+    {
+        const auto [width, height] = quilter.outputSize(args->outputWidth, args->outputHeight);
+        outputWriter = openImageWriter(args->outputFile, width, height, outputFormat, writerOptions);
+        quilter.setRowSink([&](int, const Vec3 *row, int)
+        {
+            outputWriter->writeRow(row);
+        });
+    }
+
+    if(!args->renderMapFile.empty() && args->mipLevels != 1)
     {
-        return Vec3(math::from_color3b<float>(c));
-    }));
+        const MipPyramid sourceLevels(sourceTexture, args->mipLevels);
+        mipLevels = QuiltMap::load(args->renderMapFile).renderMipChain(
+            sourceLevels, args->threads > 0 ? args->threads :
+                static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+        outputTexture = mipLevels[0];
+    }
+    else if(!args->renderMapFile.empty())
+        outputTexture = QuiltMap::load(args->renderMapFile).render(sourceTexture);
+    else if(!args->guideFile.empty())
+    {
+        TransferParams params;
+        params.alpha  = args->transferAlpha;
+        params.passes = args->transferPasses;
+
+        outputTexture = quilter.transferTexture(
+            sourceTexture, loadTexture(args->guideFile), params, &quality);
+    }
+    else if(!args->existingFile.empty())
+    {
+        const auto existingTexture = loadTexture(args->existingFile);
+        const auto maskTexture = loadTexture(args->maskFile).map(
+            [](const Vec3 &c) { return c.lum(); });
+
+        outputTexture = quilter.quiltMaskedRegion(
+            sourceTexture, existingTexture, maskTexture);
+    }
+    else if(args->region)
+    {
+        LazyQuilter lazyQuilter(quilter, sourceTexture);
+        outputTexture = lazyQuilter.getRegion(
+            args->region->x, args->region->y, args->outputWidth, args->outputHeight);
+    }
+    else if(!args->extendStateFile.empty() && atlas)
+    {
+        outputTexture = quilter.extendTexture(
+            *atlas, QuiltState::load(args->extendStateFile),
+            args->outputWidth, args->outputHeight, &quality, statePtr, mapPtr);
+    }
+    else if(!args->extendStateFile.empty())
+    {
+        outputTexture = quilter.extendTexture(
+            sourceTexture, QuiltState::load(args->extendStateFile),
+            args->outputWidth, args->outputHeight, &quality, statePtr, mapPtr);
+    }
+    else if(atlas)
+    {
+        outputTexture = quilter.quiltTexture(
+            *atlas, args->outputWidth, args->outputHeight, &quality, statePtr, mapPtr);
+    }
+    else
+    {
+        outputTexture = quilter.quiltTexture(
+            sourceTexture, args->outputWidth, args->outputHeight, &quality, statePtr, mapPtr);
+    }
+
+    if(!args->saveStateFile.empty())
+        state.save(args->saveStateFile);
 
-    auto outputTexture = quilter.quiltTexture(
-        sourceTexture, args->outputWidth, args->outputHeight);
+    if(!args->saveMapFile.empty())
+        map.save(args->saveMapFile);
 
-    auto outputTextureU8 = outputTexture.map([](const Vec3 &c)
+    if(args->searchMode != "exhaustive" && quilting)
     {
-        return math::to_color3b<float>(c);
-    }).get_data();
+        log << "mean best MSE: " << quality.meanBestMSE
+                  << ", worst best MSE: " << quality.worstBestMSE
+                  << ", candidates evaluated: " << quality.evaluatedCandidates
+                  << std::endl;
+    }
 
-    file::create_directory_for_file(args->outputFile);
+    if(!args->statsFile.empty())
+        saveQuiltStats(args->statsFile);
 
-    const std::string lowerOutput = to_lower(args->outputFile);
-    if(ends_with(lowerOutput, ".png"))
-        save_rgb_to_png_file(args->outputFile, outputTextureU8);
-    else if(ends_with(lowerOutput, ".jpg"))
-        save_rgb_to_jpg_file(args->outputFile, outputTextureU8);
-    else if(ends_with(lowerOutput, ".bmp"))
-        save_rgb_to_bmp_file(args->outputFile, outputTextureU8);
+    auto saveTexture = [&](const std::string &filename, const Texture<Vec3> &texture)
+    {
+        saveImage(filename, texture, outputFormat, writerOptions);
+    };
+
+    if(outputWriter)
+        outputWriter->finish();
     else
-        throw std::runtime_error(
-            "unsupported output format: " + args->outputFile);
+        saveTexture(args->outputFile, outputTexture);
+
+    // further mip levels go to <output stem>_mip<level><extension> next to
+    // the output, which may have no extension
+    const std::filesystem::path outputPath(args->outputFile);
+    for(size_t level = 1; level < mipLevels.size(); ++level)
+    {
+        const std::filesystem::path levelPath = outputPath.parent_path() /
+            (outputPath.stem().string() + "_mip" + std::to_string(level) +
+             outputPath.extension().string());
+        saveTexture(levelPath.string(), mipLevels[level]);
+    }
 
-    std::cout << "Texture generation complete..." << std::endl;
+    log << "Texture generation complete..." << std::endl;
 }
 
 int main(int argc, char *argv[])